@@ -0,0 +1,168 @@
+#include "archive.h"
+#include "crc32.h"
+#include "inflate.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Largest ROM image we are willing to allocate for (well above any NES ROM).
+enum { ARCHIVE_MAX_ROM = 16 * 1024 * 1024 };
+
+static void set_err(char *err, size_t cap, const char *msg) {
+  if (!err || cap == 0) return;
+  snprintf(err, cap, "%s", msg);
+}
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool is_gzip(const uint8_t *d, size_t n) { return n >= 18 && d[0] == 0x1F && d[1] == 0x8B; }
+static bool is_zip(const uint8_t *d, size_t n) { return n >= 22 && d[0] == 'P' && d[1] == 'K' && d[2] == 3 && d[3] == 4; }
+
+bool archive_is_compressed(const uint8_t *data, size_t size) { return is_gzip(data, size) || is_zip(data, size); }
+
+// Decodes `method` (0 = stored, 8 = deflate) into a fresh buffer and checks the CRC.
+static bool unpack(const uint8_t *src, size_t src_len, int method, uint32_t usize, uint32_t crc,
+                   uint8_t **out, size_t *out_size, char *err, size_t err_cap) {
+  if (usize == 0 || usize > ARCHIVE_MAX_ROM) {
+    set_err(err, err_cap, "archive entry has an implausible size for a ROM");
+    return false;
+  }
+  uint8_t *buf = (uint8_t *)malloc(usize);
+  if (!buf) {
+    set_err(err, err_cap, "oom decompressing ROM");
+    return false;
+  }
+  size_t got = 0;
+  bool ok;
+  if (method == 0) {
+    ok = src_len >= usize;
+    if (ok) memcpy(buf, src, usize);
+    got = usize;
+  } else if (method == 8) {
+    ok = inflate_raw(src, src_len, buf, usize, &got);
+  } else {
+    free(buf);
+    set_err(err, err_cap, "unsupported compression method in archive");
+    return false;
+  }
+  if (!ok || got != usize) {
+    free(buf);
+    set_err(err, err_cap, "corrupt or truncated compressed ROM");
+    return false;
+  }
+  if (crc32_update(0, buf, usize) != crc) {
+    free(buf);
+    set_err(err, err_cap, "CRC mismatch in compressed ROM");
+    return false;
+  }
+  *out = buf;
+  *out_size = usize;
+  return true;
+}
+
+static bool extract_gzip(const uint8_t *d, size_t n, uint8_t **out, size_t *out_size, char *err, size_t err_cap) {
+  if (d[2] != 8) {
+    set_err(err, err_cap, "unsupported gzip compression method");
+    return false;
+  }
+  uint8_t flags = d[3];
+  size_t pos = 10;
+  if (flags & 0x04) { // FEXTRA
+    if (pos + 2 > n) goto truncated;
+    pos += 2u + rd16(d + pos);
+  }
+  for (int bit = 0x08; bit <= 0x10; bit <<= 1) { // FNAME, FCOMMENT: zero-terminated
+    if (!(flags & bit)) continue;
+    while (pos < n && d[pos] != 0) pos++;
+    pos++;
+  }
+  if (flags & 0x02) pos += 2; // FHCRC
+  if (pos + 8 > n) goto truncated;
+  return unpack(d + pos, n - 8 - pos, 8, rd32(d + n - 4), rd32(d + n - 8), out, out_size, err, err_cap);
+truncated:
+  set_err(err, err_cap, "truncated gzip header");
+  return false;
+}
+
+static bool has_nes_ext(const uint8_t *name, size_t len) {
+  if (len < 4) return false;
+  const uint8_t *e = name + len - 4;
+  return e[0] == '.' && tolower(e[1]) == 'n' && tolower(e[2]) == 'e' && tolower(e[3]) == 's';
+}
+
+static bool extract_zip(const uint8_t *d, size_t n, uint8_t **out, size_t *out_size, char *err, size_t err_cap) {
+  // End of central directory: last 22+ bytes, possibly followed by a comment.
+  size_t eocd = 0;
+  bool found = false;
+  size_t lo = n > 22 + 0xFFFF ? n - 22 - 0xFFFF : 0;
+  for (size_t i = n - 22 + 1; i-- > lo;) {
+    if (rd32(d + i) == 0x06054B50u) {
+      eocd = i;
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    set_err(err, err_cap, "zip: end of central directory not found");
+    return false;
+  }
+  uint16_t entries = rd16(d + eocd + 10);
+  size_t pos = rd32(d + eocd + 16);
+
+  // Prefer the first *.nes entry; fall back to the first entry.
+  size_t first = 0, pick = 0;
+  bool have_first = false, have_nes = false;
+  for (uint16_t i = 0; i < entries && !have_nes; i++) {
+    if (pos + 46 > n || rd32(d + pos) != 0x02014B50u || pos + 46u + rd16(d + pos + 28) > n) {
+      set_err(err, err_cap, "zip: corrupt central directory");
+      return false;
+    }
+    size_t name_len = rd16(d + pos + 28);
+    if (!have_first) {
+      first = pos;
+      have_first = true;
+    }
+    if (has_nes_ext(d + pos + 46, name_len)) {
+      pick = pos;
+      have_nes = true;
+    }
+    pos += 46u + name_len + rd16(d + pos + 30) + rd16(d + pos + 32);
+  }
+  if (!have_first) {
+    set_err(err, err_cap, "zip: archive is empty");
+    return false;
+  }
+  if (!have_nes) pick = first;
+
+  const uint8_t *c = d + pick;
+  if (rd16(c + 8) & 0x0001) {
+    set_err(err, err_cap, "zip: encrypted entries are not supported");
+    return false;
+  }
+  int method = rd16(c + 10);
+  uint32_t crc = rd32(c + 16);
+  uint32_t csize = rd32(c + 20);
+  uint32_t usize = rd32(c + 24);
+  size_t local = rd32(c + 42);
+  if (local + 30 > n || rd32(d + local) != 0x04034B50u) {
+    set_err(err, err_cap, "zip: corrupt local header");
+    return false;
+  }
+  size_t data = local + 30u + rd16(d + local + 26) + rd16(d + local + 28);
+  if (data > n || csize > n - data) {
+    set_err(err, err_cap, "zip: truncated entry");
+    return false;
+  }
+  return unpack(d + data, csize, method, usize, crc, out, out_size, err, err_cap);
+}
+
+bool archive_extract_rom(const uint8_t *data, size_t size, uint8_t **out, size_t *out_size, char *err, size_t err_cap) {
+  if (is_gzip(data, size)) return extract_gzip(data, size, out, out_size, err, err_cap);
+  if (is_zip(data, size)) return extract_zip(data, size, out, out_size, err, err_cap);
+  set_err(err, err_cap, "not a gzip or zip archive");
+  return false;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "common.h"
+
+// True if the buffer starts with a gzip or zip signature.
+bool archive_is_compressed(const uint8_t *data, size_t size);
+
+// Decompresses a .gz file or the first .nes entry of a .zip (stored or
+// deflated) into a malloc'd buffer the caller frees. CRCs are verified.
+bool archive_extract_rom(const uint8_t *data, size_t size, uint8_t **out, size_t *out_size, char *err, size_t err_cap);
@@ -0,0 +1,124 @@
+#include "cheat.h"
+#include "nes.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int gg_letter(char ch) {
+  static const char letters[] = "APZLGITYEOXUKSVN";
+  const char *p = strchr(letters, toupper((unsigned char)ch));
+  return (p && ch) ? (int)(p - letters) : -1;
+}
+
+static bool parse_game_genie(const char *code, cheat_t *out) {
+  size_t len = strlen(code);
+  if (len != 6 && len != 8) return false;
+  int n[8];
+  for (size_t i = 0; i < len; i++) {
+    n[i] = gg_letter(code[i]);
+    if (n[i] < 0) return false;
+  }
+  out->addr = (uint16_t)(0x8000 + (((n[3] & 7) << 12) | ((n[5] & 7) << 8) | ((n[4] & 8) << 8) |
+                                   ((n[2] & 7) << 4) | ((n[1] & 8) << 4) | (n[4] & 7) | (n[3] & 8)));
+  if (len == 6) {
+    out->value = (uint8_t)(((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7) | (n[5] & 8));
+    out->compare = -1;
+  } else {
+    out->value = (uint8_t)(((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7) | (n[7] & 8));
+    out->compare = (int16_t)(((n[7] & 7) << 4) | ((n[6] & 8) << 4) | (n[6] & 7) | (n[5] & 8));
+  }
+  return true;
+}
+
+static bool parse_raw(const char *code, cheat_t *out) {
+  unsigned addr, a, b;
+  char sep, tail;
+  if (sscanf(code, "%4x%c%2x:%2x%c", &addr, &sep, &a, &b, &tail) == 4 && sep == '?') {
+    out->addr = (uint16_t)addr;
+    out->compare = (int16_t)a;
+    out->value = (uint8_t)b;
+    return true;
+  }
+  if (sscanf(code, "%4x:%2x%c", &addr, &a, &tail) == 2) {
+    out->addr = (uint16_t)addr;
+    out->compare = -1;
+    out->value = (uint8_t)a;
+    return true;
+  }
+  return false;
+}
+
+bool cheat_parse(const char *code, cheat_t *out, char *err, size_t err_cap) {
+  if (parse_raw(code, out) || parse_game_genie(code, out)) return true;
+  if (err && err_cap) snprintf(err, err_cap, "bad cheat '%s' (expected Game Genie, AAAA:VV or AAAA?CC:VV)", code);
+  return false;
+}
+
+static void rebuild_pages(cheat_set_t *s) {
+  memset(s->page_mask, 0, sizeof(s->page_mask));
+  for (int i = 0; i < s->rom_count; i++) {
+    uint32_t page = (uint32_t)(s->rom[i].addr - 0x8000) >> 8;
+    s->page_mask[page >> 5] |= 1u << (page & 31);
+  }
+}
+
+bool cheat_add(struct nes *nn, const char *code, char *err, size_t err_cap) {
+  nes_t *n = (nes_t *)nn;
+  cheat_t c;
+  if (!cheat_parse(code, &c, err, err_cap)) return false;
+  bool rom = c.addr >= 0x8000;
+  if (!rom && !(c.addr < 0x2000 || (c.addr >= 0x6000 && c.addr < 0x8000))) {
+    if (err && err_cap) snprintf(err, err_cap, "cheat '%s' targets I/O space $%04X", code, c.addr);
+    return false;
+  }
+  if (!n->cheats) {
+    n->cheats = (cheat_set_t *)calloc(1, sizeof(cheat_set_t));
+    if (!n->cheats) {
+      if (err && err_cap) snprintf(err, err_cap, "oom cheats");
+      return false;
+    }
+  }
+  cheat_set_t *s = n->cheats;
+  int *count = rom ? &s->rom_count : &s->ram_count;
+  if (*count >= CHEAT_MAX) {
+    if (err && err_cap) snprintf(err, err_cap, "too many cheats (max %d)", CHEAT_MAX);
+    return false;
+  }
+  (rom ? s->rom : s->ram)[(*count)++] = c;
+  if (rom) {
+    rebuild_pages(s);
+    cpu6502_icache_patch_rom(n->icache, nn, c.addr);
+  } else {
+    cheat_apply_ram(nn);
+  }
+  return true;
+}
+
+void cheat_clear(struct nes *nn) {
+  nes_t *n = (nes_t *)nn;
+  cheat_set_t *s = n->cheats;
+  if (!s) return;
+  n->cheats = NULL;
+  // Re-decode with the patches gone.
+  for (int i = 0; i < s->rom_count; i++) cpu6502_icache_patch_rom(n->icache, nn, s->rom[i].addr);
+  free(s);
+}
+
+void cheat_apply_ram(struct nes *nn) {
+  nes_t *n = (nes_t *)nn;
+  const cheat_set_t *s = n->cheats;
+  for (int i = 0; i < s->ram_count; i++) {
+    const cheat_t *c = &s->ram[i];
+    if (c->compare >= 0 && nes_cpu_peek(n, c->addr) != c->compare) continue;
+    nes_cpu_poke(n, c->addr, c->value);
+  }
+}
+
+uint8_t cheat_patch_rom(const cheat_set_t *s, uint16_t addr, uint8_t orig) {
+  for (int i = 0; i < s->rom_count; i++) {
+    const cheat_t *c = &s->rom[i];
+    if (c->addr == addr && (c->compare < 0 || c->compare == orig)) return c->value;
+  }
+  return orig;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "common.h"
+
+struct nes;
+
+// Game Genie (6/8 letters) or raw "AAAA:VV" / "AAAA?CC:VV" codes. Codes at
+// $8000+ patch PRG ROM reads; codes on RAM or PRG RAM hold the value there
+// (re-written every frame), or with a compare byte replace it only on the
+// frames it reads CC.
+typedef struct {
+  uint16_t addr;
+  uint8_t value;
+  int16_t compare; // -1 = unconditional; otherwise only replaces this original byte
+} cheat_t;
+
+enum { CHEAT_MAX = 64 };
+
+typedef struct cheat_set {
+  cheat_t rom[CHEAT_MAX];
+  int rom_count;
+  cheat_t ram[CHEAT_MAX];
+  int ram_count;
+  // PRG ROM pages (256 bytes each, $8000-$FFFF) with at least one patch.
+  // Reads from other pages never look at the patch list.
+  uint32_t page_mask[4];
+} cheat_set_t;
+
+bool cheat_parse(const char *code, cheat_t *out, char *err, size_t err_cap);
+bool cheat_add(struct nes *n, const char *code, char *err, size_t err_cap);
+void cheat_clear(struct nes *n);
+void cheat_apply_ram(struct nes *n);
+
+static inline bool cheat_page_patched(const cheat_set_t *s, uint16_t addr) {
+  uint32_t page = (uint32_t)(addr - 0x8000) >> 8;
+  return (s->page_mask[page >> 5] >> (page & 31)) & 1;
+}
+uint8_t cheat_patch_rom(const cheat_set_t *s, uint16_t addr, uint8_t orig);
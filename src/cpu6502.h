@@ -7,14 +7,59 @@ typedef struct cpu6502 {
   uint16_t pc;
   uint8_t a, x, y;
   uint8_t sp;
-  uint8_t p;
+  uint8_t p; // I, D and the unused bits only; use cpu6502_get_p() for the full register
+  // Lazily evaluated flags: N = bit 7 of flag_n, Z = (flag_z == 0),
+  // C = flag_c (0/1), V = bit 7 of flag_v.
+  uint8_t flag_n, flag_z, flag_c, flag_v;
   uint64_t cycles;
   bool nmi_pending;
   bool irq_pending;
 } cpu6502_t;
 
+// Pre-decoded instruction: opcode plus operand bytes as fetched from the bus.
+typedef struct {
+  uint16_t operand;
+  uint8_t op;
+  uint8_t len;  // instruction length in bytes; 0 = not cached, fetch from the bus
+  uint8_t last; // last byte the fetch reads (what the original fetch leaves on the open bus)
+} cpu6502_decoded_t;
+
+// Idle-loop class of a ROM address, as the head of a short loop that only
+// loads, compares and branches on RAM, ROM or $2002 (0 = not looked at yet).
+enum {
+  CPU6502_IDLE_CHECKED = 0x8000,   // classified; with a zero count: not an idle loop
+  CPU6502_IDLE_READS_PPU = 0x4000, // polls $2002
+  CPU6502_IDLE_SPAN_SHIFT = 8,     // 6 bits: bytes from the head to the closing branch/JMP
+  CPU6502_IDLE_COUNT_MASK = 0x1F,  // instructions per pass
+};
+
+// Decoded-instruction cache keyed by PC. ROM entries are built once at load;
+// RAM entries are decoded lazily and invalidated per 256-byte page on write.
+typedef struct cpu6502_icache {
+  cpu6502_decoded_t rom[0x8000]; // $8000-$FFFF
+  cpu6502_decoded_t ram[0x0800]; // $0000-$07FF (mirrors share entries)
+  uint64_t ram_gen[0x0800];      // page generation each RAM entry was decoded under
+  uint64_t ram_page_gen[8];
+  uint16_t idle[0x8000];         // CPU6502_IDLE_* per ROM loop head, filled in when first jumped to
+} cpu6502_icache_t;
+
 void cpu6502_reset(cpu6502_t *c, struct nes *nes);
 int cpu6502_step(cpu6502_t *c, struct nes *nes); // returns CPU cycles used
+// Runs instructions back to back until max_cycles have elapsed, max_steps were
+// executed, the bus flagged a PPU/DMA access, an interrupt became pending, or
+// a branch closed a candidate idle loop (nes->cpu_idle_hint, PC at its head).
+// Returns the number of steps executed.
+int cpu6502_run(cpu6502_t *c, struct nes *nes, int max_cycles, int max_steps);
+int cpu6502_op_length(uint8_t op);
+uint8_t cpu6502_get_p(const cpu6502_t *c);
+void cpu6502_set_p(cpu6502_t *c, uint8_t p);
 void cpu6502_set_nmi(cpu6502_t *c);
 void cpu6502_set_irq(cpu6502_t *c, bool level);
 
+void cpu6502_icache_build(cpu6502_icache_t *ic, struct nes *nes);
+void cpu6502_icache_flush_ram(cpu6502_icache_t *ic);
+// Re-decodes the ROM entries whose bytes include `addr` (after a cheat patch changes it).
+void cpu6502_icache_patch_rom(cpu6502_icache_t *ic, struct nes *nes, uint16_t addr);
+static inline void cpu6502_icache_ram_write(cpu6502_icache_t *ic, uint16_t addr) {
+  ic->ram_page_gen[(addr >> 8) & 7]++;
+}
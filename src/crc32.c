@@ -0,0 +1,33 @@
+#define _POSIX_C_SOURCE 200809L
+#include "crc32.h"
+#include <pthread.h>
+
+// Slicing-by-4 tables, generated once on first use (callers may be on any thread).
+static uint32_t table[4][256];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static void build_table(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+    table[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    table[1][i] = (table[0][i] >> 8) ^ table[0][table[0][i] & 0xFF];
+    table[2][i] = (table[1][i] >> 8) ^ table[0][table[1][i] & 0xFF];
+    table[3][i] = (table[2][i] >> 8) ^ table[0][table[2][i] & 0xFF];
+  }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t n) {
+  pthread_once(&table_once, build_table);
+  crc = ~crc;
+  while (n >= 4) {
+    crc ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    crc = table[3][crc & 0xFF] ^ table[2][(crc >> 8) & 0xFF] ^ table[1][(crc >> 16) & 0xFF] ^ table[0][crc >> 24];
+    data += 4;
+    n -= 4;
+  }
+  while (n--) crc = table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
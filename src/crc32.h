@@ -0,0 +1,6 @@
+#pragma once
+#include "common.h"
+
+// CRC-32 (IEEE 802.3, as used by zip/gzip and ROM databases).
+// Start with crc = 0 and feed data in any number of chunks.
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t n);
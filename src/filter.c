@@ -0,0 +1,483 @@
+#define _POSIX_C_SOURCE 200809L
+#include "filter.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum { W = 256, H = 240 };
+
+static const char *const filter_names[FILTER_COUNT] = { "none", "scale2x", "scale3x", "xbr-lite", "crt", "ntsc", "ntsc-640" };
+static const int filter_scales[FILTER_COUNT] = { 1, 2, 3, 2, 3, 3, 3 };
+
+// NTSC: a pixel is 8 samples of the composite signal and a colour cycle is
+// 12, so the subcarrier phase repeats every `group` pixels, which decode to
+// `outs` output pixels. Each line starts 4 samples (one of 3 burst phases)
+// later than the one above.
+static const struct ntsc_mode {
+  int width, group, outs;
+} ntsc_modes[2] = { { 602, 3, 7 }, { 640, 6, 15 } };
+enum { NTSC_PAD = 8, NTSC_ACC = 640 + 2 * NTSC_PAD + FILTER_NTSC_TAPS };
+
+static bool is_ntsc(filter_kind_t kind) { return kind == FILTER_NTSC || kind == FILTER_NTSC_640; }
+
+bool filter_parse(const char *name, filter_kind_t *out) {
+  for (int k = 0; k < FILTER_COUNT; k++) {
+    if (strcmp(name, filter_names[k]) == 0) {
+      *out = (filter_kind_t)k;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *filter_name(filter_kind_t kind) { return filter_names[kind]; }
+int filter_width(filter_kind_t kind) {
+  return is_ntsc(kind) ? ntsc_modes[kind == FILTER_NTSC_640].width : W * filter_scales[kind];
+}
+int filter_height(filter_kind_t kind) { return H * filter_scales[kind]; }
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Source row y (clamped to the frame) with its edge pixels repeated on both
+// sides: pad[x + 1] is pixel x, so the neighbours at x - 1 and x + 1 are
+// plain loads.
+static void load_row(uint8_t *pad, const uint8_t *index, int y) {
+  if (y < 0) y = 0;
+  if (y >= H) y = H - 1;
+  const uint8_t *row = index + y * W;
+  pad[0] = row[0];
+  memcpy(pad + 1, row, W);
+  pad[W + 1] = row[W - 1];
+}
+
+// Edge kernels: from the padded rows above (u), at (c) and below (d), write
+// the index of every output sub-pixel, one plane per sub-pixel position.
+// Neighbour names follow the Scale2x/Scale3x description:
+//   A B C
+//   D E F
+//   G H I
+#if defined(__SSE2__)
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+
+static inline __m128i select16(__m128i m, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+static void scale2x_row(const uint8_t *u, const uint8_t *c, const uint8_t *d, uint8_t out[][W]) {
+  for (int x = 0; x < W; x += 16) {
+    __m128i b = LOAD(u + x + 1), dd = LOAD(c + x), e = LOAD(c + x + 1), f = LOAD(c + x + 2), h = LOAD(d + x + 1);
+    // Corners only change where B != H and D != F.
+    __m128i quiet = _mm_or_si128(_mm_cmpeq_epi8(b, h), _mm_cmpeq_epi8(dd, f));
+    STORE(out[0] + x, select16(_mm_andnot_si128(quiet, _mm_cmpeq_epi8(dd, b)), dd, e));
+    STORE(out[1] + x, select16(_mm_andnot_si128(quiet, _mm_cmpeq_epi8(b, f)), f, e));
+    STORE(out[2] + x, select16(_mm_andnot_si128(quiet, _mm_cmpeq_epi8(dd, h)), dd, e));
+    STORE(out[3] + x, select16(_mm_andnot_si128(quiet, _mm_cmpeq_epi8(h, f)), f, e));
+  }
+}
+
+static void scale3x_row(const uint8_t *u, const uint8_t *c, const uint8_t *d, uint8_t out[][W]) {
+  for (int x = 0; x < W; x += 16) {
+    __m128i a = LOAD(u + x), b = LOAD(u + x + 1), cc = LOAD(u + x + 2);
+    __m128i dd = LOAD(c + x), e = LOAD(c + x + 1), f = LOAD(c + x + 2);
+    __m128i g = LOAD(d + x), h = LOAD(d + x + 1), i = LOAD(d + x + 2);
+    __m128i quiet = _mm_or_si128(_mm_cmpeq_epi8(b, h), _mm_cmpeq_epi8(dd, f));
+    __m128i db = _mm_andnot_si128(quiet, _mm_cmpeq_epi8(dd, b));
+    __m128i bf = _mm_andnot_si128(quiet, _mm_cmpeq_epi8(b, f));
+    __m128i dh = _mm_andnot_si128(quiet, _mm_cmpeq_epi8(dd, h));
+    __m128i hf = _mm_andnot_si128(quiet, _mm_cmpeq_epi8(h, f));
+    __m128i ea = _mm_cmpeq_epi8(e, a), ec = _mm_cmpeq_epi8(e, cc);
+    __m128i eg = _mm_cmpeq_epi8(e, g), ei = _mm_cmpeq_epi8(e, i);
+    STORE(out[0] + x, select16(db, dd, e));
+    STORE(out[1] + x, select16(_mm_or_si128(_mm_andnot_si128(ec, db), _mm_andnot_si128(ea, bf)), b, e));
+    STORE(out[2] + x, select16(bf, f, e));
+    STORE(out[3] + x, select16(_mm_or_si128(_mm_andnot_si128(eg, db), _mm_andnot_si128(ea, dh)), dd, e));
+    STORE(out[4] + x, e);
+    STORE(out[5] + x, select16(_mm_or_si128(_mm_andnot_si128(ei, bf), _mm_andnot_si128(ec, hf)), f, e));
+    STORE(out[6] + x, select16(dh, dd, e));
+    STORE(out[7] + x, select16(_mm_or_si128(_mm_andnot_si128(ei, dh), _mm_andnot_si128(eg, hf)), h, e));
+    STORE(out[8] + x, select16(hf, f, e));
+  }
+}
+#else
+static void scale2x_row(const uint8_t *u, const uint8_t *c, const uint8_t *d, uint8_t out[][W]) {
+  for (int x = 0; x < W; x++) {
+    uint8_t b = u[x + 1], dd = c[x], e = c[x + 1], f = c[x + 2], h = d[x + 1];
+    bool act = b != h && dd != f;
+    out[0][x] = act && dd == b ? dd : e;
+    out[1][x] = act && b == f ? f : e;
+    out[2][x] = act && dd == h ? dd : e;
+    out[3][x] = act && h == f ? f : e;
+  }
+}
+
+static void scale3x_row(const uint8_t *u, const uint8_t *c, const uint8_t *d, uint8_t out[][W]) {
+  for (int x = 0; x < W; x++) {
+    uint8_t a = u[x], b = u[x + 1], cc = u[x + 2];
+    uint8_t dd = c[x], e = c[x + 1], f = c[x + 2];
+    uint8_t g = d[x], h = d[x + 1], i = d[x + 2];
+    bool act = b != h && dd != f;
+    bool db = act && dd == b, bf = act && b == f, dh = act && dd == h, hf = act && h == f;
+    out[0][x] = db ? dd : e;
+    out[1][x] = (db && e != cc) || (bf && e != a) ? b : e;
+    out[2][x] = bf ? f : e;
+    out[3][x] = (db && e != g) || (dh && e != a) ? dd : e;
+    out[4][x] = e;
+    out[5][x] = (bf && e != i) || (hf && e != cc) ? f : e;
+    out[6][x] = dh ? dd : e;
+    out[7][x] = (dh && e != i) || (hf && e != g) ? h : e;
+    out[8][x] = hf ? f : e;
+  }
+}
+#endif
+
+static inline uint32_t *out_row(const filter_t *f, int y) {
+  return (uint32_t *)((uint8_t *)f->dst + (size_t)y * (size_t)f->pitch);
+}
+
+// Per-channel average of two ARGB pixels (exact when they are equal).
+static inline uint32_t blend50(uint32_t a, uint32_t b) { return (a & b) + (((a ^ b) & 0xFEFEFEFEu) >> 1); }
+
+// Precomputed share of one input pixel in the decoded line: the taps of
+// pixel x start at accumulator slot base[x] (see draw_ntsc_band()).
+static inline const int16_t *ntsc_kernel(const filter_t *f, const struct ntsc_mode *m, int mode, int entry, int j,
+                                         int phase) {
+  return f->ntsc[mode] + ((size_t)(entry * m->group + j) * 3 + (size_t)phase) * FILTER_NTSC_TAPS * 4;
+}
+
+// First output pixel (relative to its group) that pixel `j` of a group reaches.
+static int ntsc_first_tap(const struct ntsc_mode *m, int j) {
+  double spacing = 8.0 * m->group / m->outs; // samples per output pixel
+  return (int)floor((8 * j - 12) / spacing - 0.5) + 1;
+}
+
+// Each line is accumulated from the kernels of its pixels, then written
+// three times: twice as decoded and once at half brightness (scanline gap).
+static void draw_ntsc_band(filter_t *f, int y0, int y1) {
+  int mode = f->kind == FILTER_NTSC_640;
+  const struct ntsc_mode *m = &ntsc_modes[mode];
+  int first[6];
+  for (int j = 0; j < m->group; j++) first[j] = ntsc_first_tap(m, j);
+  int16_t base[W];
+  uint8_t group_pos[W];
+  for (int x = 0; x < W; x++) {
+    group_pos[x] = (uint8_t)(x % m->group);
+    base[x] = (int16_t)(((x / m->group) * m->outs + first[x % m->group] + NTSC_PAD) * 4);
+  }
+  int16_t acc[NTSC_ACC * 4];
+  for (int y = y0; y < y1; y++) {
+    memset(acc, 0, sizeof(acc));
+    const uint8_t *index = f->index + y * W;
+    int row = (f->emphasis[y] & 7) << 6;
+    int phase = (int)((f->ntsc_field + (unsigned)y) % 3u);
+    for (int x = 0; x < W; x++) {
+      const int16_t *k = ntsc_kernel(f, m, mode, row | (index[x] & 63), group_pos[x], phase);
+      int16_t *a = acc + base[x];
+#if defined(__SSE2__)
+      for (int t = 0; t < FILTER_NTSC_TAPS * 4; t += 8) STORE(a + t, _mm_add_epi16(LOAD(a + t), LOAD(k + t)));
+#else
+      for (int t = 0; t < FILTER_NTSC_TAPS * 4; t++) a[t] = (int16_t)(a[t] + k[t]);
+#endif
+    }
+    uint32_t *o0 = out_row(f, y * 3), *o1 = out_row(f, y * 3 + 1), *o2 = out_row(f, y * 3 + 2);
+    const int16_t *src = acc + NTSC_PAD * 4;
+#if defined(__SSE2__)
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u), round = _mm_set1_epi16(16);
+    for (int x = 0; x < m->width; x += 2) {
+      __m128i v = _mm_add_epi16(LOAD(src + x * 4), round);
+      __m128i full = _mm_or_si128(_mm_packus_epi16(_mm_srai_epi16(v, 5), _mm_setzero_si128()), alpha);
+      __m128i half = _mm_or_si128(_mm_packus_epi16(_mm_srai_epi16(v, 6), _mm_setzero_si128()), alpha);
+      _mm_storel_epi64((__m128i *)(o0 + x), full);
+      _mm_storel_epi64((__m128i *)(o1 + x), full);
+      _mm_storel_epi64((__m128i *)(o2 + x), half);
+    }
+#else
+    for (int x = 0; x < m->width; x++) {
+      uint32_t full = 0xFF000000u, half = 0xFF000000u;
+      for (int c = 0; c < 3; c++) {
+        int v = src[x * 4 + c] + 16;
+        int vf = v >> 5, vh = v >> 6;
+        full |= (uint32_t)(vf < 0 ? 0 : vf > 255 ? 255 : vf) << (8 * c);
+        half |= (uint32_t)(vh < 0 ? 0 : vh > 255 ? 255 : vh) << (8 * c);
+      }
+      o0[x] = full;
+      o1[x] = full;
+      o2[x] = half;
+    }
+#endif
+  }
+}
+
+static void draw_band(filter_t *f, int band) {
+  int y0 = H * band / f->threads, y1 = H * (band + 1) / f->threads;
+  if (is_ntsc(f->kind)) {
+    draw_ntsc_band(f, y0, y1);
+    return;
+  }
+  int s = filter_scales[f->kind];
+  uint8_t rows[3][W + 2];
+  uint8_t planes[9][W];
+  uint8_t *u = rows[0], *c = rows[1], *d = rows[2];
+  load_row(u, f->index, y0 - 1);
+  load_row(c, f->index, y0);
+  for (int y = y0; y < y1; y++) {
+    load_row(d, f->index, y + 1);
+    const uint8_t *e = c + 1;
+    int row = (f->emphasis[y] & 7) << 6;
+    const uint32_t *rgb = f->rgb + row;
+    switch (f->kind) {
+      case FILTER_NONE: {
+        uint32_t *o = out_row(f, y);
+        for (int x = 0; x < W; x++) o[x] = rgb[e[x]];
+      } break;
+      case FILTER_SCALE2X:
+      case FILTER_XBR_LITE: {
+        scale2x_row(u, c, d, planes);
+        uint32_t *o0 = out_row(f, y * 2), *o1 = out_row(f, y * 2 + 1);
+        if (f->kind == FILTER_SCALE2X) {
+          for (int x = 0; x < W; x++) {
+            o0[x * 2] = rgb[planes[0][x]];
+            o0[x * 2 + 1] = rgb[planes[1][x]];
+            o1[x * 2] = rgb[planes[2][x]];
+            o1[x * 2 + 1] = rgb[planes[3][x]];
+          }
+        } else {
+          // Where Scale2x would move an edge through a corner, show half of
+          // each colour instead: diagonals come out anti-aliased.
+          for (int x = 0; x < W; x++) {
+            uint32_t px = rgb[e[x]];
+            o0[x * 2] = blend50(px, rgb[planes[0][x]]);
+            o0[x * 2 + 1] = blend50(px, rgb[planes[1][x]]);
+            o1[x * 2] = blend50(px, rgb[planes[2][x]]);
+            o1[x * 2 + 1] = blend50(px, rgb[planes[3][x]]);
+          }
+        }
+      } break;
+      case FILTER_SCALE3X: {
+        scale3x_row(u, c, d, planes);
+        for (int r = 0; r < 3; r++) {
+          uint32_t *o = out_row(f, y * 3 + r);
+          const uint8_t *p0 = planes[r * 3], *p1 = planes[r * 3 + 1], *p2 = planes[r * 3 + 2];
+          for (int x = 0; x < W; x++) {
+            o[x * 3] = rgb[p0[x]];
+            o[x * 3 + 1] = rgb[p1[x]];
+            o[x * 3 + 2] = rgb[p2[x]];
+          }
+        }
+      } break;
+      case FILTER_CRT:
+        for (int r = 0; r < 3; r++) {
+          uint32_t *o = out_row(f, y * s + r);
+          const uint32_t *m0 = f->crt[r][0] + row, *m1 = f->crt[r][1] + row, *m2 = f->crt[r][2] + row;
+          for (int x = 0; x < W; x++) {
+            o[x * 3] = m0[e[x]];
+            o[x * 3 + 1] = m1[e[x]];
+            o[x * 3 + 2] = m2[e[x]];
+          }
+        }
+        break;
+      default:
+        break;
+    }
+    uint8_t *t = u;
+    u = c;
+    c = d;
+    d = t;
+  }
+}
+
+static void *worker_main(void *arg) {
+  struct filter_worker *w = (struct filter_worker *)arg;
+  filter_t *f = w->f;
+  uint64_t seen = 0; // workers start before the first frame
+  pthread_mutex_lock(&f->lock);
+  for (;;) {
+    while (f->gen == seen && !f->stop) pthread_cond_wait(&f->go, &f->lock);
+    if (f->stop) break;
+    seen = f->gen;
+    pthread_mutex_unlock(&f->lock);
+    draw_band(f, w->band);
+    pthread_mutex_lock(&f->lock);
+    if (--f->pending == 0) pthread_cond_signal(&f->done);
+  }
+  pthread_mutex_unlock(&f->lock);
+  return NULL;
+}
+
+static uint32_t scale_rgb(uint32_t c, int r, int g, int b) {
+  uint32_t rr = ((c >> 16) & 0xFF) * (uint32_t)r >> 8;
+  uint32_t gg = ((c >> 8) & 0xFF) * (uint32_t)g >> 8;
+  uint32_t bb = (c & 0xFF) * (uint32_t)b >> 8;
+  return (c & 0xFF000000u) | (rr << 16) | (gg << 8) | bb;
+}
+
+static void build_tables(filter_t *f, const uint32_t *palette) {
+  // Aperture grille: each column of a 3x3 cell favours one channel; the
+  // bottom row is the dark gap between scanlines.
+  static const int mask[3][3] = { { 256, 170, 170 }, { 170, 256, 170 }, { 170, 170, 256 } };
+  static const int row_gain[3] = { 256, 256, 128 };
+  memcpy(f->rgb, palette, sizeof(f->rgb));
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      for (int i = 0; i < PALETTE_SIZE; i++) {
+        f->crt[r][c][i] = scale_rgb(f->rgb[i], mask[c][0] * row_gain[r] >> 8, mask[c][1] * row_gain[r] >> 8,
+                                    mask[c][2] * row_gain[r] >> 8);
+      }
+    }
+  }
+}
+
+static double hann(double d, double half_width) {
+  return fabs(d) < half_width ? 0.5 + 0.5 * cos(3.14159265358979323846 * d / half_width) : 0.0;
+}
+
+// The NTSC kernels. Every palette entry is encoded as Y + I cos + Q sin of
+// the subcarrier phase and decoded with a luma window of 18 samples (which
+// lets some chroma through: dot crawl and fringes) and a chroma window of two
+// colour cycles (colour bleed). Both steps are linear, so the share of one
+// pixel in one output pixel is a 3x3 matrix applied to the entry's RGB. Each
+// output width's kernels are built the first time that width is drawn.
+static bool build_ntsc_tables(filter_t *f, int mode) {
+  static const double rgb_to_yiq[3][3] = { { 0.299, 0.587, 0.114 }, { 0.596, -0.274, -0.322 }, { 0.211, -0.523, 0.312 } };
+  static const double yiq_to_rgb[3][3] = { { 1.0, 0.956, 0.621 }, { 1.0, -0.272, -0.647 }, { 1.0, -1.106, 1.703 } };
+  const double pi = 3.14159265358979323846, luma_half = 9.0, chroma_half = 12.0;
+  const struct ntsc_mode *m = &ntsc_modes[mode];
+  double spacing = 8.0 * m->group / m->outs;
+  size_t count = (size_t)PALETTE_SIZE * (size_t)m->group * 3u * FILTER_NTSC_TAPS * 4u;
+  f->ntsc[mode] = (int16_t *)malloc(count * sizeof(int16_t));
+  if (!f->ntsc[mode]) return false;
+  for (int j = 0; j < m->group; j++) {
+    int first = ntsc_first_tap(m, j);
+    for (int phase = 0; phase < 3; phase++) {
+      for (int tap = 0; tap < FILTER_NTSC_TAPS; tap++) {
+        // Decoder response at this output pixel to pixel j's samples.
+        double centre = (first + tap + 0.5) * spacing;
+        double luma_sum = 0.0, chroma_sum = 0.0, a[3][3] = { { 0 } };
+        for (int t = (int)ceil(centre - chroma_half); t <= (int)floor(centre + chroma_half); t++) {
+          double wy = hann(t - centre, luma_half), wc = hann(t - centre, chroma_half);
+          luma_sum += wy;
+          chroma_sum += wc;
+          if (t < 8 * j || t >= 8 * j + 8) continue;
+          double theta = 2.0 * pi * (t + 4 * phase) / 12.0, c = cos(theta), s = sin(theta);
+          double carrier[3] = { 1.0, c, s }; // signal per unit of Y, I, Q
+          for (int k = 0; k < 3; k++) {
+            a[0][k] += wy * carrier[k];
+            a[1][k] += 2.0 * wc * c * carrier[k];
+            a[2][k] += 2.0 * wc * s * carrier[k];
+          }
+        }
+        // RGB out per RGB in: yiq_to_rgb * (a / window sums) * rgb_to_yiq.
+        double mat[3][3];
+        for (int r = 0; r < 3; r++) {
+          for (int c = 0; c < 3; c++) {
+            double v = 0.0;
+            for (int k = 0; k < 3; k++) {
+              for (int l = 0; l < 3; l++) v += yiq_to_rgb[r][k] * a[k][l] / (k == 0 ? luma_sum : chroma_sum) * rgb_to_yiq[l][c];
+            }
+            mat[r][c] = v;
+          }
+        }
+        for (int e = 0; e < PALETTE_SIZE; e++) {
+          int16_t *out = f->ntsc[mode] + ((size_t)(e * m->group + j) * 3 + (size_t)phase) * FILTER_NTSC_TAPS * 4 + tap * 4;
+          double in[3] = { (double)((f->rgb[e] >> 16) & 0xFF), (double)((f->rgb[e] >> 8) & 0xFF), (double)(f->rgb[e] & 0xFF) };
+          for (int r = 0; r < 3; r++) {
+            double v = (mat[r][0] * in[0] + mat[r][1] * in[1] + mat[r][2] * in[2]) * 32.0;
+            v = v < -32768.0 ? -32768.0 : v > 32767.0 ? 32767.0 : v;
+            out[2 - r] = (int16_t)lround(v); // B, G, R, 0 as in ARGB little-endian
+          }
+          out[3] = 0;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool filter_init(filter_t *f, int threads, const uint32_t *palette, char *err, size_t err_cap) {
+  memset(f, 0, sizeof(*f));
+  if (threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (int)cpus : 1;
+  }
+  if (threads > FILTER_MAX_THREADS) threads = FILTER_MAX_THREADS;
+  f->threads = threads;
+  build_tables(f, palette);
+  pthread_mutex_init(&f->lock, NULL);
+  pthread_cond_init(&f->go, NULL);
+  pthread_cond_init(&f->done, NULL);
+  for (int i = 1; i < threads; i++) {
+    f->workers[i].f = f;
+    f->workers[i].band = i;
+    if (pthread_create(&f->workers[i].thread, NULL, worker_main, &f->workers[i]) != 0) {
+      f->threads = i; // stop the ones already running
+      filter_free(f);
+      if (err && err_cap) snprintf(err, err_cap, "cannot start filter threads");
+      return false;
+    }
+  }
+  return true;
+}
+
+void filter_free(filter_t *f) {
+  pthread_mutex_lock(&f->lock);
+  f->stop = true;
+  pthread_cond_broadcast(&f->go);
+  pthread_mutex_unlock(&f->lock);
+  for (int i = 1; i < f->threads; i++) pthread_join(f->workers[i].thread, NULL);
+  pthread_mutex_destroy(&f->lock);
+  pthread_cond_destroy(&f->go);
+  pthread_cond_destroy(&f->done);
+  free(f->ntsc[0]);
+  free(f->ntsc[1]);
+  f->ntsc[0] = f->ntsc[1] = NULL;
+  f->threads = 0;
+}
+
+bool filter_run(filter_t *f, filter_kind_t kind, const uint8_t *index, const uint8_t *emphasis, uint32_t *dst,
+                int pitch) {
+  int mode = kind == FILTER_NTSC_640;
+  if (is_ntsc(kind) && !f->ntsc[mode] && !build_ntsc_tables(f, mode)) return false;
+  uint64_t t0 = now_ns();
+  f->kind = kind;
+  f->index = index;
+  f->emphasis = emphasis;
+  f->dst = dst;
+  f->pitch = pitch;
+  if (is_ntsc(kind)) f->ntsc_field ^= 1; // odd frames are one dot short
+  if (f->threads > 1) {
+    pthread_mutex_lock(&f->lock);
+    f->pending = f->threads - 1;
+    f->gen++;
+    pthread_cond_broadcast(&f->go);
+    pthread_mutex_unlock(&f->lock);
+  }
+  draw_band(f, 0);
+  if (f->threads > 1) {
+    pthread_mutex_lock(&f->lock);
+    while (f->pending > 0) pthread_cond_wait(&f->done, &f->lock);
+    pthread_mutex_unlock(&f->lock);
+  }
+  f->frames[kind]++;
+  f->ns[kind] += now_ns() - t0;
+  return true;
+}
+
+void filter_set_field(filter_t *f, unsigned field) { f->ntsc_field = field & 1u; }
+
+void filter_report(const filter_t *f, FILE *out) {
+  for (int k = 0; k < FILTER_COUNT; k++) {
+    if (!f->frames[k]) continue;
+    fprintf(out, "filter: %s %dx%d, %llu frames, %.3f ms/frame (%d thread%s)\n", filter_names[k],
+            filter_width((filter_kind_t)k), filter_height((filter_kind_t)k), (unsigned long long)f->frames[k],
+            (double)f->ns[k] / (double)f->frames[k] / 1e6, f->threads, f->threads == 1 ? "" : "s");
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "common.h"
+#include "palette.h"
+#include <pthread.h>
+#include <stdio.h>
+
+// Software upscaling for the window (and headless benchmarks). Filters read
+// the PPU's palette-index plane, not the ARGB framebuffer: edge detection
+// compares one byte per pixel (16 at a time with SSE2) and colours are only
+// looked up while writing the scaled output, from the palette row of each
+// line's emphasis bits. The frame is split into horizontal bands, one per
+// thread.
+typedef enum {
+  FILTER_NONE = 0, // 1x, same as the framebuffer
+  FILTER_SCALE2X,  // Scale2x (EPX)
+  FILTER_SCALE3X,  // Scale3x (AdvMAME3x)
+  FILTER_XBR_LITE, // 2x: Scale2x edges, new corners blended 50/50 with the pixel
+  FILTER_CRT,      // 3x: RGB aperture mask and dimmed scanline gaps
+  FILTER_NTSC,     // 602x720: composite signal decoded (artifacts, colour bleed), scanline gaps
+  FILTER_NTSC_640, // 640x720: the same sampled 5 to 2 instead of 7 to 3
+  FILTER_COUNT
+} filter_kind_t;
+
+enum { FILTER_MAX_THREADS = 16 };
+// FILTER_NTSC*: output pixels one input pixel's signal reaches.
+enum { FILTER_NTSC_TAPS = 12 };
+
+typedef struct filter {
+  int threads; // bands per frame; the caller's thread draws band 0
+  struct filter_worker {
+    struct filter *f;
+    int band;
+    pthread_t thread;
+  } workers[FILTER_MAX_THREADS]; // [0] unused
+  pthread_mutex_t lock;
+  pthread_cond_t go, done;
+  uint64_t gen; // bumped once per frame
+  int pending;  // bands still being drawn by workers
+  bool stop;
+
+  // The frame being drawn.
+  filter_kind_t kind;
+  const uint8_t *index;
+  const uint8_t *emphasis; // per line
+  uint32_t *dst;
+  int pitch; // bytes
+
+  uint32_t rgb[PALETTE_SIZE];       // output palette: (emphasis << 6) | index
+  uint32_t crt[3][3][PALETTE_SIZE]; // FILTER_CRT: [row in cell][column in cell][entry]
+  // FILTER_NTSC*: what one pixel adds to the decoded line, per [entry][pixel
+  // in the repeating group][burst phase of the line]: FILTER_NTSC_TAPS output
+  // pixels of B, G, R, 0 as int16 (x32). [0] is for 602, [1] for 640 wide.
+  int16_t *ntsc[2];
+  unsigned ntsc_field; // flips every NTSC frame: the colour burst moves with it (dot crawl)
+
+  // Per-filter totals for filter_report().
+  uint64_t frames[FILTER_COUNT];
+  uint64_t ns[FILTER_COUNT];
+} filter_t;
+
+// `threads` <= 0 picks one per online CPU (at most FILTER_MAX_THREADS).
+// `palette` (PALETTE_SIZE entries) is copied. The NTSC kernels are built by
+// the first filter_run() of each NTSC width.
+bool filter_init(filter_t *f, int threads, const uint32_t *palette, char *err, size_t err_cap);
+void filter_free(filter_t *f);
+
+bool filter_parse(const char *name, filter_kind_t *out);
+const char *filter_name(filter_kind_t kind);
+// Output size in pixels.
+int filter_width(filter_kind_t kind);
+int filter_height(filter_kind_t kind);
+
+// Draws one 256x240 index frame (with its 240 line emphasis values, PPUMASK
+// bits 5-7) into `dst` (ARGB, filter_width() x filter_height(), `pitch` bytes
+// per row) and adds the time taken to the filter's total. False (nothing
+// drawn) if the NTSC kernels could not be allocated.
+bool filter_run(filter_t *f, filter_kind_t kind, const uint8_t *index, const uint8_t *emphasis, uint32_t *dst,
+                int pitch);
+// Sets the NTSC burst field (only bit 0 is used). Every filter_run() of an
+// NTSC kind flips the field before drawing (dot crawl), so passing n makes the
+// next run draw the way frame n (from 0) of a fresh filter_t did.
+void filter_set_field(filter_t *f, unsigned field);
+// One line per filter used: frames and time per frame.
+void filter_report(const filter_t *f, FILE *out);
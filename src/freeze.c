@@ -0,0 +1,79 @@
+#include "freeze.h"
+#include "crc32.h"
+#include "nes.h"
+#include <string.h>
+
+void freeze_init(freeze_detector_t *d, uint32_t window) {
+  memset(d, 0, sizeof(*d));
+  d->window = window ? window : 1;
+}
+
+static void add_pc(freeze_run_t *r, uint16_t pc) {
+  if (r->frames++ == 0) {
+    r->pc_min = r->pc_max = pc;
+  } else {
+    if (pc < r->pc_min) r->pc_min = pc;
+    if (pc > r->pc_max) r->pc_max = pc;
+  }
+  if (r->pc_max - r->pc_min >= FREEZE_MAX_SPAN) r->pc_spread = true;
+  for (int i = 0; i < r->pc_count; i++) {
+    if (r->pcs[i] == pc) {
+      r->pc_hits[i]++;
+      return;
+    }
+  }
+  if (r->pc_count == FREEZE_MAX_PCS) {
+    r->pc_spread = true;
+    return;
+  }
+  r->pcs[r->pc_count] = pc;
+  r->pc_hits[r->pc_count] = 1;
+  r->pc_count++;
+}
+
+static bool looping(const freeze_detector_t *d, const freeze_run_t *r) {
+  return r->frames >= d->window && !r->pc_spread;
+}
+
+bool freeze_frame(freeze_detector_t *d, const struct nes *nn) {
+  const nes_t *n = (const nes_t *)nn;
+  // 10KB of CRC per frame, against 240KB for a framebuffer hash.
+  uint32_t crc = crc32_update(0, n->ram, sizeof(n->ram));
+  if (n->cart.prg_ram) crc = crc32_update(crc, n->cart.prg_ram, 0x2000);
+  uint64_t nmis = n->dbg_nmi_count;
+  if (nmis != d->nmi_count) {
+    memset(&d->no_nmi, 0, sizeof(d->no_nmi));
+  } else {
+    add_pc(&d->no_nmi, n->cpu.pc);
+    // NMI is off from power-on, so boot code would spread this run for
+    // good: start over from the first frame that left the block.
+    if (d->no_nmi.pc_spread) {
+      memset(&d->no_nmi, 0, sizeof(d->no_nmi));
+      add_pc(&d->no_nmi, n->cpu.pc);
+    }
+  }
+  d->nmi_count = nmis;
+  if (crc != d->ram_crc) {
+    d->ram_crc = crc;
+    d->nmi_start = nmis;
+    memset(&d->stable, 0, sizeof(d->stable));
+  } else {
+    add_pc(&d->stable, n->cpu.pc);
+  }
+  return looping(d, &d->stable) || looping(d, &d->no_nmi);
+}
+
+void freeze_report(const freeze_detector_t *d, FILE *out) {
+  const freeze_run_t *r = &d->stable;
+  if (looping(d, r)) {
+    fprintf(out, "freeze: RAM unchanged for %u frames, CPU looping in $%04X-$%04X (%s)\n", r->frames, r->pc_min,
+            r->pc_max, d->nmi_count != d->nmi_start ? "NMI still running" : "no NMI");
+  } else {
+    r = &d->no_nmi;
+    fprintf(out, "freeze: no NMI for %u frames, CPU looping in $%04X-$%04X (RAM still changing)\n", r->frames,
+            r->pc_min, r->pc_max);
+  }
+  fprintf(out, "freeze: frame-end PCs:");
+  for (int i = 0; i < r->pc_count; i++) fprintf(out, " $%04X x%u", r->pcs[i], r->pc_hits[i]);
+  fprintf(out, "\n");
+}
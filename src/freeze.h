@@ -0,0 +1,39 @@
+#pragma once
+#include "common.h"
+#include <stdio.h>
+
+struct nes;
+
+// Hang detector for unattended runs. Once per frame it fingerprints the
+// machine: CRC of CPU RAM and PRG RAM, the NMI count and the PC where the
+// frame ended. A hang is a run of `window` frames in which every frame ended
+// inside the same small block of code (a tight loop) and either RAM never
+// changed or no NMI was taken. The second case catches loops that keep
+// writing (`loop: inc $00 / jmp loop`). Static screens whose NMI handler
+// still ticks a counter are not hangs.
+enum { FREEZE_MAX_PCS = 16, FREEZE_MAX_SPAN = 64 };
+
+// Frame-end PCs of one run of frames.
+typedef struct {
+  uint32_t frames;
+  uint16_t pc_min, pc_max;
+  bool pc_spread;       // PCs left a FREEZE_MAX_SPAN window or there were too many distinct PCs
+  uint16_t pcs[FREEZE_MAX_PCS]; // per-PC histogram
+  uint32_t pc_hits[FREEZE_MAX_PCS];
+  int pc_count;
+} freeze_run_t;
+
+typedef struct {
+  uint32_t window;
+  uint32_t ram_crc;
+  uint64_t nmi_start;   // NMI count when the RAM-stable run began
+  uint64_t nmi_count;   // latest NMI count
+  freeze_run_t stable;  // frames with unchanged RAM
+  freeze_run_t no_nmi;  // frames without an NMI
+} freeze_detector_t;
+
+void freeze_init(freeze_detector_t *d, uint32_t window);
+// Call after every frame; true once the machine looks hung.
+bool freeze_frame(freeze_detector_t *d, const struct nes *n);
+// Looping PC range, the PCs it ended frames on and whether NMIs still ran.
+void freeze_report(const freeze_detector_t *d, FILE *out);
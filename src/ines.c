@@ -1,4 +1,7 @@
 #include "ines.h"
+#include "archive.h"
+#include "crc32.h"
+#include "romdb.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,88 +13,112 @@ static void set_err(char *err, size_t cap, const char *msg) {
 
 void cart_free(cart_t *cart) {
   if (!cart) return;
-  free(cart->prg_rom);
-  free(cart->chr);
+  if (cart->chr_is_ram) free(cart->chr);
+  free(cart->prg_ram);
+  free(cart->image);
   memset(cart, 0, sizeof(*cart));
 }
 
-static bool read_exact(FILE *f, void *buf, size_t n) {
-  return fread(buf, 1, n, f) == n;
+static uint32_t nes2_rom_size(uint8_t lsb, uint8_t msb, uint32_t unit, bool *ok) {
+  if (msb != 0x0F) return (((uint32_t)msb << 8) | lsb) * unit;
+  // Exponent-multiplier form: 2^E * (MM * 2 + 1) bytes.
+  uint32_t e = lsb >> 2, mm = lsb & 3;
+  if (e > 24) {
+    *ok = false;
+    return 0;
+  }
+  return (1u << e) * (mm * 2 + 1);
 }
 
-bool ines_load(cart_t *cart, const char *path, char *err, size_t err_cap) {
-  memset(cart, 0, sizeof(*cart));
-  FILE *f = fopen(path, "rb");
-  if (!f) {
-    set_err(err, err_cap, "failed to open ROM");
-    return false;
+static uint32_t nes2_ram_size(uint8_t shift) { return shift ? (64u << shift) : 0; }
+
+bool ines_parse_header(ines_info_t *info, const uint8_t h[16]) {
+  memset(info, 0, sizeof(*info));
+  uint8_t flags6 = h[6];
+  uint8_t flags7 = h[7];
+  bool nes2 = ((flags7 & 0x0C) == 0x08);
+
+  info->is_nes2 = nes2;
+  info->has_trainer = (flags6 & 0x04) != 0;
+  info->has_battery = (flags6 & 0x02) != 0;
+  if (flags6 & 0x08) info->mirror = NES_MIRROR_FOURSCREEN;
+  else info->mirror = (flags6 & 0x01) ? NES_MIRROR_VERTICAL : NES_MIRROR_HORIZONTAL;
+
+  uint16_t mapper_lo = (uint16_t)(flags6 >> 4);
+  uint16_t mapper_hi = (uint16_t)(flags7 >> 4);
+  if (nes2) {
+    bool ok = true;
+    info->mapper = (uint16_t)(mapper_lo | (mapper_hi << 4) | ((h[8] & 0x0F) << 8));
+    info->submapper = (uint8_t)(h[8] >> 4);
+    info->prg_rom_size = nes2_rom_size(h[4], h[9] & 0x0F, 16u * 1024u, &ok);
+    info->chr_rom_size = nes2_rom_size(h[5], h[9] >> 4, 8u * 1024u, &ok);
+    info->prg_ram_size = nes2_ram_size(h[10] & 0x0F);
+    info->prg_nvram_size = nes2_ram_size(h[10] >> 4);
+    info->chr_ram_size = nes2_ram_size(h[11] & 0x0F);
+    info->chr_nvram_size = nes2_ram_size(h[11] >> 4);
+    info->timing = (nes_timing_t)(h[12] & 3);
+    info->console_type = (uint8_t)((flags7 & 3) == 3 ? (h[13] & 0x0F) : (flags7 & 3));
+    return ok;
   }
 
-  uint8_t h[16];
-  if (!read_exact(f, h, sizeof(h))) {
-    fclose(f);
+  // iNES 1: bytes 12-15 must be zero; old rippers left text there ("DiskDude!"),
+  // in which case byte 7 is garbage too.
+  bool dirty_tail = (h[12] | h[13] | h[14] | h[15]) != 0;
+  if ((flags7 & 0x0C) == 0x04 || dirty_tail) mapper_hi = 0;
+  info->mapper = (uint16_t)(mapper_lo | (mapper_hi << 4));
+  info->prg_rom_size = (uint32_t)h[4] * 16u * 1024u;
+  info->chr_rom_size = (uint32_t)h[5] * 8u * 1024u;
+  info->prg_ram_size = (h[8] ? (uint32_t)h[8] * 8u * 1024u : 8u * 1024u);
+  info->console_type = dirty_tail ? 0 : (uint8_t)(flags7 & 3);
+  info->timing = (!dirty_tail && (h[9] & 1)) ? NES_TIMING_PAL : NES_TIMING_NTSC;
+  return true;
+}
+
+bool ines_load_mem(cart_t *cart, const uint8_t *data, size_t size, char *err, size_t err_cap) {
+  memset(cart, 0, sizeof(*cart));
+  if (size < 16) {
     set_err(err, err_cap, "failed to read header");
     return false;
   }
+  const uint8_t *h = data;
   if (h[0] == 0x7F && h[1] == 'E' && h[2] == 'L' && h[3] == 'F') {
-    fclose(f);
     set_err(err, err_cap, "input is an ELF executable, not an iNES .nes ROM");
     return false;
   }
   if (!(h[0] == 'N' && h[1] == 'E' && h[2] == 'S' && h[3] == 0x1A)) {
-    fclose(f);
     set_err(err, err_cap, "not an iNES ROM (missing NES\\x1A header)");
     return false;
   }
 
-  uint8_t prg_chunks = h[4];
-  uint8_t chr_chunks = h[5];
-  uint8_t flags6 = h[6];
-  uint8_t flags7 = h[7];
-  uint8_t prg_ram_chunks = h[8];
-  uint8_t flags9 = h[9];
-  (void)flags9;
-
-  bool nes2 = ((flags7 & 0x0C) == 0x08);
-  if (nes2) {
-    // Keep simple: treat as iNES1 for now.
+  if (!ines_parse_header(&cart->info, h)) {
+    set_err(err, err_cap, "NES 2.0 header declares an impossible ROM size");
+    return false;
   }
 
-  cart->info.is_nes2 = nes2;
-  cart->info.has_trainer = (flags6 & 0x04) != 0;
-  cart->info.has_battery = (flags6 & 0x02) != 0;
-  if (flags6 & 0x08) cart->info.mirror = NES_MIRROR_FOURSCREEN;
-  else cart->info.mirror = (flags6 & 0x01) ? NES_MIRROR_VERTICAL : NES_MIRROR_HORIZONTAL;
-
-  uint8_t mapper_lo = (flags6 >> 4);
-  uint8_t mapper_hi = (flags7 >> 4);
-  cart->info.mapper = (uint8_t)(mapper_lo | (mapper_hi << 4));
-
-  cart->info.prg_rom_size = (uint32_t)prg_chunks * 16u * 1024u;
-  cart->info.chr_rom_size = (uint32_t)chr_chunks * 8u * 1024u;
-  cart->info.prg_ram_size = (prg_ram_chunks ? (uint32_t)prg_ram_chunks * 8u * 1024u : 8u * 1024u);
-
+  size_t pos = 16;
   if (cart->info.has_trainer) {
-    uint8_t trainer[512];
-    if (!read_exact(f, trainer, sizeof(trainer))) {
-      fclose(f);
+    if (size - pos < 512) {
       set_err(err, err_cap, "failed to read trainer");
       return false;
     }
+    pos += 512;
   }
 
-  cart->prg_rom = (uint8_t *)malloc(cart->info.prg_rom_size ? cart->info.prg_rom_size : 1);
-  if (!cart->prg_rom) {
-    fclose(f);
-    set_err(err, err_cap, "oom PRG");
-    return false;
-  }
-  if (!read_exact(f, cart->prg_rom, cart->info.prg_rom_size)) {
-    fclose(f);
-    cart_free(cart);
+  // Known dumps are identified by content, so a wrong header cannot pick the
+  // wrong mapper, mirroring or ROM split. Only PRG + CHR is hashed: trailing
+  // bytes (title blocks, padding) would make a known dump miss the lookup.
+  size_t rom_bytes = (size_t)cart->info.prg_rom_size + (size_t)cart->info.chr_rom_size;
+  if (rom_bytes > size - pos) rom_bytes = size - pos;
+  cart->info.crc32 = crc32_update(0, data + pos, rom_bytes);
+  const romdb_entry_t *db = romdb_lookup(cart->info.crc32);
+  if (db) romdb_apply(db, &cart->info);
+
+  if (size - pos < cart->info.prg_rom_size) {
     set_err(err, err_cap, "failed reading PRG ROM");
     return false;
   }
+  cart->prg_rom = data + pos;
+  pos += cart->info.prg_rom_size;
 
   if (cart->info.chr_rom_size == 0) {
     cart->chr_is_ram = true;
@@ -99,21 +126,77 @@ bool ines_load(cart_t *cart, const char *path, char *err, size_t err_cap) {
     cart->chr = (uint8_t *)calloc(1, cart->info.chr_rom_size);
   } else {
     cart->chr_is_ram = false;
-    cart->chr = (uint8_t *)malloc(cart->info.chr_rom_size);
-    if (cart->chr && !read_exact(f, cart->chr, cart->info.chr_rom_size)) {
-      fclose(f);
+    if (size - pos < cart->info.chr_rom_size) {
       cart_free(cart);
       set_err(err, err_cap, "failed reading CHR");
       return false;
     }
+    // Only CHR RAM is ever written through this pointer.
+    cart->chr = (uint8_t *)(uintptr_t)(data + pos);
   }
   if (!cart->chr) {
-    fclose(f);
     cart_free(cart);
     set_err(err, err_cap, "oom CHR");
     return false;
   }
 
-  fclose(f);
+  // Always map a PRG-RAM window: many NROM homebrew and test ROMs (e.g. the
+  // blargg result protocol at $6000) expect it even when the header says 0.
+  cart->prg_ram = (uint8_t *)calloc(1, 8u * 1024u);
+  if (!cart->prg_ram) {
+    cart_free(cart);
+    set_err(err, err_cap, "oom PRG RAM");
+    return false;
+  }
   return true;
 }
+
+bool ines_load_owned(cart_t *cart, uint8_t *image, size_t size, char *err, size_t err_cap) {
+  memset(cart, 0, sizeof(*cart));
+  if (archive_is_compressed(image, size)) {
+    uint8_t *rom = NULL;
+    size_t rom_size = 0;
+    bool ok = archive_extract_rom(image, size, &rom, &rom_size, err, err_cap);
+    free(image);
+    if (!ok) return false;
+    image = rom;
+    size = rom_size;
+  }
+  if (!ines_load_mem(cart, image, size, err, err_cap)) {
+    free(image);
+    return false;
+  }
+  cart->image = image;
+  return true;
+}
+
+bool ines_load(cart_t *cart, const char *path, char *err, size_t err_cap) {
+  memset(cart, 0, sizeof(*cart));
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    set_err(err, err_cap, "failed to open ROM");
+    return false;
+  }
+  // One read into a buffer sized from the file; the cart then points into it.
+  long file_size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+  if (file_size < 0 || fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    set_err(err, err_cap, "failed reading ROM");
+    return false;
+  }
+  uint8_t *buf = (uint8_t *)malloc(file_size ? (size_t)file_size : 1);
+  if (!buf) {
+    fclose(f);
+    set_err(err, err_cap, "oom reading ROM");
+    return false;
+  }
+  size_t len = fread(buf, 1, (size_t)file_size, f);
+  bool read_failed = ferror(f) != 0;
+  fclose(f);
+  if (read_failed) {
+    free(buf);
+    set_err(err, err_cap, "failed reading ROM");
+    return false;
+  }
+  return ines_load_owned(cart, buf, len, err, err_cap);
+}
@@ -7,24 +7,50 @@ typedef enum {
   NES_MIRROR_FOURSCREEN = 2,
 } nes_mirror_t;
 
+typedef enum {
+  NES_TIMING_NTSC = 0,
+  NES_TIMING_PAL = 1,
+  NES_TIMING_MULTI = 2,
+  NES_TIMING_DENDY = 3,
+} nes_timing_t;
+
 typedef struct {
-  uint8_t mapper;
+  uint16_t mapper;
+  uint8_t submapper;    // NES 2.0 only
+  uint8_t console_type; // 0 NES/Famicom, 1 Vs. System, 2 PlayChoice-10, 3+ extended (NES 2.0 byte 13)
   nes_mirror_t mirror;
+  nes_timing_t timing;
   bool has_battery;
   bool has_trainer;
   bool is_nes2;
   uint32_t prg_rom_size;
-  uint32_t chr_rom_size;
+  uint32_t chr_rom_size;  // CHR RAM size when chr_is_ram
   uint32_t prg_ram_size;
+  uint32_t prg_nvram_size;
+  uint32_t chr_ram_size;  // as declared by a NES 2.0 header
+  uint32_t chr_nvram_size;
+  uint32_t crc32;         // CRC-32 of PRG ROM + CHR ROM (after the header and trainer)
+  bool db_match;          // header fields were replaced from the built-in ROM database
 } ines_info_t;
 
 typedef struct {
   ines_info_t info;
-  uint8_t *prg_rom;
-  uint8_t *chr;      // CHR ROM or CHR RAM
+  const uint8_t *prg_rom; // points into the ROM image
+  uint8_t *chr;           // CHR ROM (in the image, never written) or CHR RAM
   bool chr_is_ram;
+  uint8_t *prg_ram;       // 8KB work RAM at $6000-$7FFF
+  uint32_t prg_ram_dirty; // one bit per 256-byte PRG RAM page written since the last save poll
+  uint8_t *image;         // ROM image owned by the cart (NULL when borrowed)
 } cart_t;
 
+// Decodes an iNES 1 or NES 2.0 header; false if it declares an impossible size.
+bool ines_parse_header(ines_info_t *info, const uint8_t h[16]);
+// Loads a .nes file, or the ROM inside a .gz/.zip archive.
 bool ines_load(cart_t *cart, const char *path, char *err, size_t err_cap);
+// Parses an in-memory .nes image without copying it: PRG/CHR ROM point into
+// `data`, which must outlive the cart.
+bool ines_load_mem(cart_t *cart, const uint8_t *data, size_t size, char *err, size_t err_cap);
+// Takes ownership of a malloc'd .nes/.gz/.zip image (freed on failure too).
+bool ines_load_owned(cart_t *cart, uint8_t *image, size_t size, char *err, size_t err_cap);
 void cart_free(cart_t *cart);
 
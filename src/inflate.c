@@ -0,0 +1,242 @@
+#include "inflate.h"
+#include <string.h>
+
+// Canonical Huffman decoding with a 9-bit lookup table for short codes and a
+// per-length range search for the rest (the stb_image zlib approach).
+enum { FAST_BITS = 9, FAST_SIZE = 1 << FAST_BITS };
+
+typedef struct {
+  uint16_t fast[FAST_SIZE]; // (length << 9) | symbol; 0 = code longer than FAST_BITS
+  uint16_t firstcode[16];
+  uint32_t maxcode[17];
+  uint16_t firstsym[16];
+  uint8_t size[288];
+  uint16_t value[288];
+} huff_t;
+
+typedef struct {
+  const uint8_t *in;
+  size_t in_len, in_pos;
+  size_t overrun; // zero bytes fed past the end of the input
+  uint32_t bits;
+  int nbits;
+  uint8_t *out;
+  size_t out_cap, out_pos;
+} inflater_t;
+
+static const uint16_t len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                       35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                       3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                        6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static uint32_t bit_reverse(uint32_t v, int bits) {
+  uint32_t r = 0;
+  for (int i = 0; i < bits; i++) {
+    r = (r << 1) | (v & 1);
+    v >>= 1;
+  }
+  return r;
+}
+
+static bool huff_build(huff_t *h, const uint8_t *lengths, int num) {
+  int count[17] = { 0 };
+  uint32_t next_code[16];
+  memset(h->fast, 0, sizeof(h->fast));
+  for (int i = 0; i < num; i++) count[lengths[i]]++;
+  count[0] = 0;
+  uint32_t code = 0;
+  int k = 0;
+  for (int i = 1; i < 16; i++) {
+    next_code[i] = code;
+    h->firstcode[i] = (uint16_t)code;
+    h->firstsym[i] = (uint16_t)k;
+    code += (uint32_t)count[i];
+    if (count[i] && code - 1 >= (1u << i)) return false; // over-subscribed
+    h->maxcode[i] = code << (16 - i);
+    code <<= 1;
+    k += count[i];
+  }
+  h->maxcode[16] = 0x10000;
+  for (int i = 0; i < num; i++) {
+    int s = lengths[i];
+    if (!s) continue;
+    int c = (int)(next_code[s] - h->firstcode[s]) + h->firstsym[s];
+    h->size[c] = (uint8_t)s;
+    h->value[c] = (uint16_t)i;
+    if (s <= FAST_BITS) {
+      for (uint32_t j = bit_reverse(next_code[s], s); j < FAST_SIZE; j += 1u << s) {
+        h->fast[j] = (uint16_t)((s << 9) | i);
+      }
+    }
+    next_code[s]++;
+  }
+  return true;
+}
+
+static void refill(inflater_t *z) {
+  while (z->nbits <= 24) {
+    uint32_t b = 0;
+    if (z->in_pos < z->in_len) b = z->in[z->in_pos++];
+    else z->overrun++;
+    z->bits |= b << z->nbits;
+    z->nbits += 8;
+  }
+}
+
+static uint32_t getbits(inflater_t *z, int n) {
+  if (z->nbits < n) refill(z);
+  uint32_t v = z->bits & ((1u << n) - 1);
+  z->bits >>= n;
+  z->nbits -= n;
+  return v;
+}
+
+static int decode(inflater_t *z, const huff_t *h) {
+  if (z->nbits < 16) refill(z);
+  uint16_t f = h->fast[z->bits & (FAST_SIZE - 1)];
+  if (f) {
+    int s = f >> 9;
+    z->bits >>= s;
+    z->nbits -= s;
+    return f & 511;
+  }
+  uint32_t k = bit_reverse(z->bits & 0xFFFF, 16);
+  int s;
+  for (s = FAST_BITS + 1; k >= h->maxcode[s]; s++) {
+  }
+  if (s >= 16) return -1;
+  int c = (int)(k >> (16 - s)) - h->firstcode[s] + h->firstsym[s];
+  if (c < 0 || c >= 288 || h->size[c] != s) return -1;
+  z->bits >>= s;
+  z->nbits -= s;
+  return h->value[c];
+}
+
+static bool inflate_codes(inflater_t *z, const huff_t *lit, const huff_t *dist) {
+  for (;;) {
+    int sym = decode(z, lit);
+    if (sym < 0) return false;
+    if (sym < 256) {
+      if (z->out_pos >= z->out_cap) return false;
+      z->out[z->out_pos++] = (uint8_t)sym;
+      continue;
+    }
+    if (sym == 256) return true;
+    sym -= 257;
+    if (sym >= 29) return false;
+    size_t len = len_base[sym] + getbits(z, len_extra[sym]);
+    int ds = decode(z, dist);
+    if (ds < 0 || ds >= 30) return false;
+    size_t d = dist_base[ds] + getbits(z, dist_extra[ds]);
+    if (d > z->out_pos || len > z->out_cap - z->out_pos) return false;
+    uint8_t *dst = z->out + z->out_pos;
+    const uint8_t *src = dst - d;
+    if (d >= len) {
+      memcpy(dst, src, len);
+    } else {
+      for (size_t i = 0; i < len; i++) dst[i] = src[i]; // overlapping run
+    }
+    z->out_pos += len;
+  }
+}
+
+static bool inflate_stored(inflater_t *z) {
+  getbits(z, z->nbits & 7); // to a byte boundary
+  uint32_t len = getbits(z, 16);
+  uint32_t nlen = getbits(z, 16);
+  if ((len ^ 0xFFFF) != nlen) return false;
+  if (len > z->out_cap - z->out_pos) return false;
+  // Drain whole bytes still held in the bit buffer, then copy directly.
+  while (len && z->nbits >= 8) {
+    z->out[z->out_pos++] = (uint8_t)getbits(z, 8);
+    len--;
+  }
+  if (len > z->in_len - z->in_pos) return false;
+  memcpy(z->out + z->out_pos, z->in + z->in_pos, len);
+  z->out_pos += len;
+  z->in_pos += len;
+  return true;
+}
+
+static bool inflate_fixed(inflater_t *z, huff_t *lit, huff_t *dist) {
+  uint8_t lengths[288];
+  int i = 0;
+  for (; i < 144; i++) lengths[i] = 8;
+  for (; i < 256; i++) lengths[i] = 9;
+  for (; i < 280; i++) lengths[i] = 7;
+  for (; i < 288; i++) lengths[i] = 8;
+  if (!huff_build(lit, lengths, 288)) return false;
+  for (i = 0; i < 30; i++) lengths[i] = 5;
+  if (!huff_build(dist, lengths, 30)) return false;
+  return inflate_codes(z, lit, dist);
+}
+
+static bool inflate_dynamic(inflater_t *z, huff_t *lit, huff_t *dist) {
+  static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+  int hlit = (int)getbits(z, 5) + 257;
+  int hdist = (int)getbits(z, 5) + 1;
+  int hclen = (int)getbits(z, 4) + 4;
+  if (hlit > 286 || hdist > 30) return false;
+
+  uint8_t cl_lengths[19] = { 0 };
+  for (int i = 0; i < hclen; i++) cl_lengths[order[i]] = (uint8_t)getbits(z, 3);
+  huff_t cl;
+  if (!huff_build(&cl, cl_lengths, 19)) return false;
+
+  uint8_t lengths[286 + 30];
+  int n = 0;
+  while (n < hlit + hdist) {
+    int sym = decode(z, &cl);
+    if (sym < 0) return false;
+    if (sym < 16) {
+      lengths[n++] = (uint8_t)sym;
+      continue;
+    }
+    int rep;
+    uint8_t val = 0;
+    if (sym == 16) {
+      if (n == 0) return false;
+      val = lengths[n - 1];
+      rep = 3 + (int)getbits(z, 2);
+    } else if (sym == 17) {
+      rep = 3 + (int)getbits(z, 3);
+    } else {
+      rep = 11 + (int)getbits(z, 7);
+    }
+    if (n + rep > hlit + hdist) return false;
+    while (rep--) lengths[n++] = val;
+  }
+  if (lengths[256] == 0) return false; // no end-of-block code
+  if (!huff_build(lit, lengths, hlit)) return false;
+  if (!huff_build(dist, lengths + hlit, hdist)) return false;
+  return inflate_codes(z, lit, dist);
+}
+
+bool inflate_raw(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap, size_t *out_written) {
+  inflater_t z = { 0 };
+  z.in = in;
+  z.in_len = in_len;
+  z.out = out;
+  z.out_cap = out_cap;
+  huff_t lit, dist;
+  bool ok = true;
+  bool last = false;
+  while (ok && !last) {
+    last = getbits(&z, 1) != 0;
+    switch (getbits(&z, 2)) {
+      case 0: ok = inflate_stored(&z); break;
+      case 1: ok = inflate_fixed(&z, &lit, &dist); break;
+      case 2: ok = inflate_dynamic(&z, &lit, &dist); break;
+      default: ok = false; break;
+    }
+    // Reading zeros past the end is only legal while they sit unused in the bit buffer.
+    if (z.overrun * 8 > (size_t)z.nbits) ok = false;
+  }
+  if (out_written) *out_written = z.out_pos;
+  return ok;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "common.h"
+
+// Raw DEFLATE (RFC 1951) decoder into a caller-sized buffer. The container
+// (gzip/zip) supplies the uncompressed size, so no output growth is needed.
+// Returns false on malformed or truncated input, or if the output would not
+// fit; *out_written is the number of bytes produced.
+bool inflate_raw(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap, size_t *out_written);
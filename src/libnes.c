@@ -0,0 +1,102 @@
+#include "libnes.h"
+#include "nes.h"
+#include "ramsearch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct libnes {
+  nes_t nes;
+  uint64_t frames;
+  ramsearch_t search;
+};
+
+int libnes_api_version(void) { return LIBNES_API_VERSION; }
+
+static libnes_t *create(const uint8_t *rom, size_t rom_size, bool borrow, char *err, size_t err_cap) {
+  libnes_t *h = (libnes_t *)malloc(sizeof(*h));
+  if (!h) {
+    if (err && err_cap) snprintf(err, err_cap, "oom");
+    return NULL;
+  }
+  bool ok;
+  if (borrow) {
+    ok = nes_load_mem(&h->nes, rom, rom_size, err, err_cap);
+  } else {
+    uint8_t *image = (uint8_t *)malloc(rom_size ? rom_size : 1);
+    if (!image) {
+      free(h);
+      if (err && err_cap) snprintf(err, err_cap, "oom");
+      return NULL;
+    }
+    memcpy(image, rom, rom_size);
+    ok = nes_load_owned(&h->nes, image, rom_size, err, err_cap);
+  }
+  if (!ok) {
+    free(h);
+    return NULL;
+  }
+  h->frames = 0;
+  ramsearch_reset(&h->search, (struct nes *)&h->nes);
+  return h;
+}
+
+libnes_t *libnes_create(const uint8_t *rom, size_t rom_size, char *err, size_t err_cap) {
+  return create(rom, rom_size, false, err, err_cap);
+}
+
+libnes_t *libnes_create_borrowed(const uint8_t *rom, size_t rom_size, char *err, size_t err_cap) {
+  return create(rom, rom_size, true, err, err_cap);
+}
+
+void libnes_destroy(libnes_t *h) {
+  if (!h) return;
+  nes_free(&h->nes);
+  free(h);
+}
+
+void libnes_reset(libnes_t *h) { nes_reset(&h->nes); }
+
+bool libnes_step_frame(libnes_t *h) {
+  bool ok = nes_run_frame(&h->nes, 200000);
+  if (ok) h->frames++;
+  return ok;
+}
+
+void libnes_step_cycles(libnes_t *h, uint64_t cycles) { h->frames += (uint64_t)nes_run_cycles(&h->nes, cycles); }
+
+uint64_t libnes_cpu_cycles(const libnes_t *h) { return h->nes.cpu.cycles; }
+uint64_t libnes_frame_count(const libnes_t *h) { return h->frames; }
+
+void libnes_set_input(libnes_t *h, int port, uint8_t buttons) { nes_set_pad(&h->nes, port, buttons); }
+
+const uint32_t *libnes_framebuffer(const libnes_t *h) { return h->nes.ppu.framebuffer; }
+
+uint8_t libnes_read(const libnes_t *h, uint16_t addr) { return nes_cpu_peek(&h->nes, addr); }
+void libnes_write(libnes_t *h, uint16_t addr, uint8_t v) { nes_cpu_poke(&h->nes, addr, v); }
+
+bool libnes_cheat_add(libnes_t *h, const char *code, char *err, size_t err_cap) {
+  return cheat_add((struct nes *)&h->nes, code, err, err_cap);
+}
+
+void libnes_cheat_clear(libnes_t *h) { cheat_clear((struct nes *)&h->nes); }
+
+void libnes_search_reset(libnes_t *h) { ramsearch_reset(&h->search, (struct nes *)&h->nes); }
+
+uint32_t libnes_search_filter(libnes_t *h, libnes_search_op_t op, bool against_value, uint8_t value) {
+  return ramsearch_filter(&h->search, (struct nes *)&h->nes, (ramsearch_op_t)op, against_value, value);
+}
+
+size_t libnes_search_results(const libnes_t *h, uint16_t *addrs, size_t cap) {
+  return ramsearch_results(&h->search, addrs, cap);
+}
+
+size_t libnes_state_size(const libnes_t *h) { return nes_state_size(&h->nes); }
+
+bool libnes_save_state(const libnes_t *h, void *buf, size_t cap) {
+  return nes_save_state(&h->nes, (uint8_t *)buf, cap, NULL);
+}
+
+bool libnes_load_state(libnes_t *h, const void *buf, size_t size, char *err, size_t err_cap) {
+  return nes_load_state(&h->nes, (const uint8_t *)buf, size, err, err_cap);
+}
@@ -0,0 +1,97 @@
+#pragma once
+// Embeddable emulator API (libnes.a / libnes.so). Only this header is public;
+// the machine behind the handle is opaque and free to change between builds.
+// All functions must be called from one thread per handle.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LIBNES_API __attribute__((visibility("default")))
+#else
+#define LIBNES_API
+#endif
+
+#define LIBNES_API_VERSION 1
+
+// Button bits for libnes_set_input().
+enum {
+  LIBNES_BUTTON_A = 1 << 0,
+  LIBNES_BUTTON_B = 1 << 1,
+  LIBNES_BUTTON_SELECT = 1 << 2,
+  LIBNES_BUTTON_START = 1 << 3,
+  LIBNES_BUTTON_UP = 1 << 4,
+  LIBNES_BUTTON_DOWN = 1 << 5,
+  LIBNES_BUTTON_LEFT = 1 << 6,
+  LIBNES_BUTTON_RIGHT = 1 << 7,
+};
+
+enum { LIBNES_WIDTH = 256, LIBNES_HEIGHT = 240 };
+
+typedef struct libnes libnes_t;
+
+LIBNES_API int libnes_api_version(void);
+
+// Creates a machine from an in-memory .nes image, or a .gz/.zip containing
+// one (the buffer may be freed afterwards). Returns NULL and fills err on failure.
+LIBNES_API libnes_t *libnes_create(const uint8_t *rom, size_t rom_size, char *err, size_t err_cap);
+// Zero-copy variant for uncompressed images: the machine reads PRG/CHR ROM
+// straight from `rom`, which must stay valid until libnes_destroy().
+LIBNES_API libnes_t *libnes_create_borrowed(const uint8_t *rom, size_t rom_size, char *err, size_t err_cap);
+LIBNES_API void libnes_destroy(libnes_t *h);
+LIBNES_API void libnes_reset(libnes_t *h);
+
+// Runs until the next frame is complete; false if the CPU step limit was hit first.
+LIBNES_API bool libnes_step_frame(libnes_t *h);
+// Runs at least `cycles` CPU cycles.
+LIBNES_API void libnes_step_cycles(libnes_t *h, uint64_t cycles);
+LIBNES_API uint64_t libnes_cpu_cycles(const libnes_t *h);
+LIBNES_API uint64_t libnes_frame_count(const libnes_t *h);
+
+// port 0 = controller 1, port 1 = controller 2; buttons is a mask of LIBNES_BUTTON_*.
+LIBNES_API void libnes_set_input(libnes_t *h, int port, uint8_t buttons);
+
+// Last completed frame, LIBNES_WIDTH * LIBNES_HEIGHT pixels of 0xAARRGGBB.
+// Valid until the handle is destroyed; contents change when stepping.
+LIBNES_API const uint32_t *libnes_framebuffer(const libnes_t *h);
+
+// CPU address space without side effects: RAM, PRG RAM ($6000-$7FFF) and
+// PRG ROM read; writes outside RAM/PRG RAM are ignored.
+LIBNES_API uint8_t libnes_read(const libnes_t *h, uint16_t addr);
+LIBNES_API void libnes_write(libnes_t *h, uint16_t addr, uint8_t v);
+
+// Cheats: Game Genie codes or raw "AAAA:VV" / "AAAA?CC:VV".
+LIBNES_API bool libnes_cheat_add(libnes_t *h, const char *code, char *err, size_t err_cap);
+LIBNES_API void libnes_cheat_clear(libnes_t *h);
+
+// RAM search over CPU RAM then PRG RAM. Filters compare each remaining
+// candidate against the previous snapshot (or `value` when against_value)
+// and then take a new snapshot.
+typedef enum {
+  LIBNES_SEARCH_EQ,
+  LIBNES_SEARCH_NE,
+  LIBNES_SEARCH_GT,
+  LIBNES_SEARCH_LT,
+  LIBNES_SEARCH_GE,
+  LIBNES_SEARCH_LE,
+  LIBNES_SEARCH_CHANGED_BY, // cur - prev == value
+} libnes_search_op_t;
+
+LIBNES_API void libnes_search_reset(libnes_t *h);
+// Returns the number of candidates left.
+LIBNES_API uint32_t libnes_search_filter(libnes_t *h, libnes_search_op_t op, bool against_value, uint8_t value);
+// CPU addresses of up to `cap` candidates; returns how many were written.
+LIBNES_API size_t libnes_search_results(const libnes_t *h, uint16_t *addrs, size_t cap);
+
+LIBNES_API size_t libnes_state_size(const libnes_t *h);
+// Writes a save state into buf; false if cap is smaller than libnes_state_size().
+LIBNES_API bool libnes_save_state(const libnes_t *h, void *buf, size_t cap);
+LIBNES_API bool libnes_load_state(libnes_t *h, const void *buf, size_t size, char *err, size_t err_cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,9 +1,20 @@
+#define _POSIX_C_SOURCE 200809L
+#include "filter.h"
+#include "freeze.h"
 #include "nes.h"
+#include "netplay.h"
+#include "shm_export.h"
+#include "sram.h"
+#include "video_dump.h"
+#ifndef NES_NO_SDL
 #include <SDL2/SDL.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#ifndef NES_NO_SDL
 static uint8_t pack_controller_state(const uint8_t *keys) {
   // NES pad bit order returned by reads: A, B, Select, Start, Up, Down, Left, Right
   uint8_t st = 0;
@@ -17,6 +28,13 @@ static uint8_t pack_controller_state(const uint8_t *keys) {
   if (keys[SDL_SCANCODE_RIGHT]) st |= 1 << 7;
   return st;
 }
+#endif
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
 
 static uint32_t fnv1a32(const void *data, size_t n) {
   const uint8_t *p = (const uint8_t *)data;
@@ -28,8 +46,110 @@ static uint32_t fnv1a32(const void *data, size_t n) {
   return h;
 }
 
+static void save_trace(trace_t *t, const char *path) {
+  char err[256] = {0};
+  if (!trace_save(t, path, err, sizeof(err))) {
+    fprintf(stderr, "trace: %s\n", err);
+  } else {
+    uint64_t kept = (t->total < t->cap) ? t->total : t->cap;
+    fprintf(stderr, "trace: wrote %llu of %llu instructions to %s\n",
+            (unsigned long long)kept, (unsigned long long)t->total, path);
+  }
+  trace_free(t);
+}
+
+static void save_profile(profile_t *p, const char *path) {
+  char err[256] = {0};
+  profile_report(p, stderr, 16);
+  if (!profile_save_folded(p, path, err, sizeof(err))) {
+    fprintf(stderr, "profile: %s\n", err);
+  } else {
+    fprintf(stderr, "profile: wrote folded stacks to %s\n", path);
+  }
+  profile_free(p);
+}
+
+static bool ends_with(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static void finish_video_dump(video_dump_t *d, const char *path) {
+  char err[256] = {0};
+  uint64_t frames = d->frames;
+  if (!video_dump_close(d, err, sizeof(err))) {
+    fprintf(stderr, "dump-video: %s\n", err);
+  } else {
+    fprintf(stderr, "dump-video: wrote %llu frames to %s\n", (unsigned long long)frames, path);
+  }
+}
+
+// game.nes -> game.sav (game.nes.gz -> game.sav too).
+static void default_sav_path(const char *rom_path, char *out, size_t cap) {
+  snprintf(out, cap, "%s", rom_path);
+  for (int i = 0; i < 2; i++) {
+    char *dot = strrchr(out, '.');
+    char *slash = strrchr(out, '/');
+    if (!dot || (slash && dot < slash)) break;
+    bool gz = strcmp(dot, ".gz") == 0;
+    *dot = 0;
+    if (!gz) break;
+  }
+  size_t n = strlen(out);
+  snprintf(out + n, cap - n, ".sav");
+}
+
+static void finish_sram(sram_saver_t *s) {
+  char err[256] = {0};
+  if (!sram_close(s, err, sizeof(err))) fprintf(stderr, "sram: %s\n", err);
+}
+
+// "7001:127.0.0.1:7002" -> bind port 7001, peer "127.0.0.1:7002".
+static bool open_netplay(netplay_t *np, const nes_t *nes, const char *spec, int player, int delay) {
+  char err[256] = {0};
+  char *end = NULL;
+  long port = strtol(spec, &end, 10);
+  if (end == spec || *end != ':' || port < 0 || port > 65535) {
+    fprintf(stderr, "netplay: expected <local-port>:<peer-host>:<peer-port>, got '%s'\n", spec);
+    return false;
+  }
+  fprintf(stderr, "netplay: player %d waiting for %s\n", player + 1, end + 1);
+  if (!netplay_open(np, nes, player, delay, (int)port, end + 1, 30000, err, sizeof(err))) {
+    fprintf(stderr, "netplay: %s\n", err);
+    return false;
+  }
+  return true;
+}
+
+static void finish_netplay(netplay_t *np, nes_t *nes, bool sync) {
+  char err[256] = {0};
+  if (sync && !netplay_finish(np, nes, 2000, err, sizeof(err))) fprintf(stderr, "netplay: %s\n", err);
+  netplay_report(np, stderr);
+  netplay_close(np);
+}
+
+static void print_rom_info(const char *path, const ines_info_t *info, bool chr_is_ram) {
+  static const char *mirrors[] = { "horizontal", "vertical", "four-screen" };
+  static const char *timings[] = { "NTSC", "PAL", "multi-region", "Dendy" };
+  printf("file:      %s\n", path);
+  printf("format:    %s%s\n", info->is_nes2 ? "NES 2.0" : "iNES", info->db_match ? " (corrected from ROM database)" : "");
+  printf("crc32:     %08X\n", info->crc32);
+  printf("mapper:    %u.%u\n", info->mapper, info->submapper);
+  printf("mirroring: %s\n", mirrors[info->mirror]);
+  printf("timing:    %s\n", timings[info->timing]);
+  printf("prg rom:   %u KB\n", info->prg_rom_size / 1024);
+  if (chr_is_ram) printf("chr ram:   %u KB\n", info->chr_rom_size / 1024);
+  else printf("chr rom:   %u KB\n", info->chr_rom_size / 1024);
+  printf("prg ram:   %u bytes (+%u battery-backed)\n", info->prg_ram_size, info->prg_nvram_size);
+  printf("battery:   %s\n", info->has_battery ? "yes" : "no");
+  printf("trainer:   %s\n", info->has_trainer ? "yes" : "no");
+  if (info->console_type) printf("console:   type %u\n", info->console_type);
+}
+
 int main(int argc, char **argv) {
+  double start_time = now_sec();
   bool headless = false;
+  bool report_fps = false;
   int headless_frames = 0;
   bool unthrottled = false;
   bool debug = false;
@@ -38,6 +158,27 @@ int main(int argc, char **argv) {
   int tap_a_frames = 0;
   int tap_b_frames = 0;
   bool detect_freeze = false;
+  const char *trace_path = NULL;
+  int trace_records = 1 << 20;
+  const char *profile_path = NULL;
+  ppu_render_mode_t ppu_mode = PPU_RENDER_FAST;
+  bool raster_thread = false;
+  filter_kind_t filter_kind = FILTER_NONE;
+  int filter_threads = 0;
+  const char *palette_spec = NULL;
+  double palette_hue = 0.0, palette_saturation = 1.0;
+  int profile_period = 64;
+  const char *video_path = NULL;
+  const char *video_format = NULL;
+  const char *shm_name = NULL;
+  bool rom_info = false;
+  const char *cheat_codes[CHEAT_MAX * 2];
+  int cheat_count = 0;
+  const char *sav_path = NULL;
+  int sav_quiet_ms = 1000;
+  const char *netplay_spec = NULL;
+  int netplay_player = 1;
+  int netplay_delay = 2;
   const char *rom_path = NULL;
 
   for (int i = 1; i < argc; i++) {
@@ -53,8 +194,50 @@ int main(int argc, char **argv) {
       continue;
     }
     if (strcmp(argv[i], "--debug") == 0) { debug = true; continue; }
+    if (strcmp(argv[i], "--frames-per-sec") == 0) { report_fps = true; continue; }
+    if (strcmp(argv[i], "--rom-info") == 0) { rom_info = true; continue; }
+    if (strcmp(argv[i], "--cheat") == 0) {
+      if (i + 1 < argc) {
+        const char *code = argv[++i];
+        if (cheat_count < CHEAT_MAX * 2) cheat_codes[cheat_count++] = code;
+      }
+      continue;
+    }
     if (strcmp(argv[i], "--detect-freeze") == 0) { detect_freeze = true; continue; }
     if (strcmp(argv[i], "--unthrottled") == 0) { unthrottled = true; continue; }
+    if (strcmp(argv[i], "--trace") == 0) { if (i + 1 < argc) { trace_path = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--trace-size") == 0) { if (i + 1 < argc) { trace_records = atoi(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--ppu") == 0) {
+      if (i + 1 < argc) {
+        const char *m = argv[++i];
+        if (strcmp(m, "accurate") == 0) ppu_mode = PPU_RENDER_ACCURATE;
+        else if (strcmp(m, "fast") == 0) ppu_mode = PPU_RENDER_FAST;
+        else fprintf(stderr, "unknown --ppu mode '%s' (expected fast or accurate)\n", m);
+      }
+      continue;
+    }
+    if (strcmp(argv[i], "--raster-thread") == 0) { raster_thread = true; continue; }
+    if (strcmp(argv[i], "--filter") == 0) {
+      if (i + 1 < argc) {
+        const char *m = argv[++i];
+        if (!filter_parse(m, &filter_kind)) fprintf(stderr, "unknown --filter '%s' (expected none, scale2x, scale3x, xbr-lite, crt, ntsc or ntsc-640)\n", m);
+      }
+      continue;
+    }
+    if (strcmp(argv[i], "--filter-threads") == 0) { if (i + 1 < argc) { filter_threads = atoi(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--palette") == 0) { if (i + 1 < argc) { palette_spec = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--palette-hue") == 0) { if (i + 1 < argc) { palette_hue = atof(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--palette-saturation") == 0) { if (i + 1 < argc) { palette_saturation = atof(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--profile") == 0) { if (i + 1 < argc) { profile_path = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--profile-period") == 0) { if (i + 1 < argc) { profile_period = atoi(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--dump-video") == 0) { if (i + 1 < argc) { video_path = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--dump-video-format") == 0) { if (i + 1 < argc) { video_format = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--sav") == 0) { if (i + 1 < argc) { sav_path = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--sav-quiet-ms") == 0) { if (i + 1 < argc) { sav_quiet_ms = atoi(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--netplay") == 0) { if (i + 1 < argc) { netplay_spec = argv[++i]; } continue; }
+    if (strcmp(argv[i], "--netplay-player") == 0) { if (i + 1 < argc) { netplay_player = atoi(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--netplay-delay") == 0) { if (i + 1 < argc) { netplay_delay = atoi(argv[++i]); } continue; }
+    if (strcmp(argv[i], "--shm") == 0) { if (i + 1 < argc) { shm_name = argv[++i]; } continue; }
     if (strcmp(argv[i], "--tap-start") == 0) { if (i + 1 < argc) { tap_start_frames = atoi(argv[++i]); } continue; }
     if (strcmp(argv[i], "--tap-a") == 0) { if (i + 1 < argc) { tap_a_frames = atoi(argv[++i]); } continue; }
     if (strcmp(argv[i], "--tap-b") == 0) { if (i + 1 < argc) { tap_b_frames = atoi(argv[++i]); } continue; }
@@ -75,98 +258,293 @@ int main(int argc, char **argv) {
 
   if (!rom_path) {
     fprintf(stderr, "usage: %s path/to/game.nes\n", argv[0]);
-    fprintf(stderr, "   or: %s [--unthrottled] --headless <frames> path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--unthrottled] --headless <frames> [--frames-per-sec] path/to/game.nes\n", argv[0]);
     fprintf(stderr, "   or: %s [--unthrottled] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--ppu fast|accurate] [--raster-thread] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--filter none|scale2x|scale3x|xbr-lite|crt|ntsc|ntsc-640] [--filter-threads <n>] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--palette ntsc|file.pal] [--palette-hue <deg>] [--palette-saturation <x>] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--trace out.bin] [--trace-size <records>] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--profile out.folded] [--profile-period <cycles>] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--dump-video out.y4m|out.idx] [--dump-video-format y4m|index] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--shm /name] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s --rom-info path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--cheat GGCODE|AAAA:VV|AAAA?CC:VV]... path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s [--sav game.sav] [--sav-quiet-ms <ms>] path/to/game.nes\n", argv[0]);
+    fprintf(stderr, "   or: %s --netplay <port>:<peer-host>:<peer-port> [--netplay-player 1|2] [--netplay-delay <frames>] path/to/game.nes\n", argv[0]);
     return 2;
   }
 
-  nes_t nes;
+#ifdef NES_NO_SDL
+  if (!headless && !rom_info) {
+    fprintf(stderr, "%s: built without SDL; pass --headless <frames>\n", argv[0]);
+    return 2;
+  }
+#endif
+
   char err[256] = {0};
+  if (rom_info) {
+    // Header + database lookup only; no CPU/PPU setup.
+    cart_t cart;
+    if (!ines_load(&cart, rom_path, err, sizeof(err))) {
+      fprintf(stderr, "ROM load failed: %s\n", err[0] ? err : "unknown error");
+      return 1;
+    }
+    print_rom_info(rom_path, &cart.info, cart.chr_is_ram);
+    cart_free(&cart);
+    return 0;
+  }
+
+  nes_t nes;
   if (!nes_load(&nes, rom_path, err, sizeof(err))) {
     fprintf(stderr, "ROM load failed: %s\n", err[0] ? err : "unknown error");
     return 1;
   }
 
+  ppu_set_render_mode(&nes.ppu, ppu_mode);
+  if (palette_spec) {
+    uint32_t rgb[PALETTE_SIZE];
+    bool ok = true;
+    if (strcmp(palette_spec, "ntsc") == 0) {
+      palette_ntsc_t ntsc;
+      palette_ntsc_defaults(&ntsc);
+      ntsc.hue = palette_hue;
+      ntsc.saturation = palette_saturation;
+      palette_generate_ntsc(rgb, &ntsc);
+    } else {
+      ok = palette_load(rgb, palette_spec, err, sizeof(err));
+    }
+    if (ok) nes_set_palette(&nes, rgb);
+    else fprintf(stderr, "palette: %s (using the built-in one)\n", err);
+  }
+  if (raster_thread && !nes_set_raster_thread(&nes, true, err, sizeof(err))) fprintf(stderr, "raster-thread: %s\n", err);
+  for (int i = 0; i < cheat_count; i++) {
+    if (!cheat_add((struct nes *)&nes, cheat_codes[i], err, sizeof(err))) fprintf(stderr, "cheat: %s\n", err);
+  }
+
+  trace_t trace;
+  if (trace_path) {
+    if (!trace_init(&trace, trace_records > 0 ? (uint32_t)trace_records : 1u)) {
+      fprintf(stderr, "trace: failed to allocate %d records\n", trace_records);
+      nes_free(&nes);
+      return 1;
+    }
+    nes.trace = &trace;
+  }
+
+  profile_t profile;
+  if (profile_path) {
+    if (!profile_init(&profile, profile_period > 0 ? (uint32_t)profile_period : 1u)) {
+      fprintf(stderr, "profile: out of memory\n");
+      if (trace_path) trace_free(&trace);
+      nes_free(&nes);
+      return 1;
+    }
+    nes.profile = &profile;
+  }
+
+  video_dump_t video;
+  if (video_path) {
+    video_dump_format_t fmt = ends_with(video_path, ".y4m") ? VIDEO_DUMP_Y4M : VIDEO_DUMP_INDEX;
+    if (video_format && strcmp(video_format, "y4m") == 0) fmt = VIDEO_DUMP_Y4M;
+    else if (video_format && strcmp(video_format, "index") == 0) fmt = VIDEO_DUMP_INDEX;
+    else if (video_format) fprintf(stderr, "unknown --dump-video-format '%s' (expected y4m or index)\n", video_format);
+    if (!video_dump_open(&video, video_path, fmt, nes.palette, err, sizeof(err))) {
+      fprintf(stderr, "dump-video: %s\n", err);
+      if (trace_path) trace_free(&trace);
+      if (profile_path) profile_free(&profile);
+      nes_free(&nes);
+      return 1;
+    }
+  }
+
+  // Battery-backed PRG RAM: load the .sav now, save it from a writer thread.
+  sram_saver_t sram;
+  bool use_sram = nes.cart.info.has_battery || sav_path != NULL;
+  if (use_sram) {
+    char sav_buf[1024];
+    if (!sav_path) {
+      default_sav_path(rom_path, sav_buf, sizeof(sav_buf));
+      sav_path = sav_buf;
+    }
+    if (!sram_load(&nes.cart, sav_path, err, sizeof(err)) ||
+        !sram_open(&sram, &nes.cart, sav_path, sav_quiet_ms > 0 ? (uint32_t)sav_quiet_ms : 0u, err, sizeof(err))) {
+      fprintf(stderr, "sram: %s (battery saves disabled)\n", err);
+      use_sram = false;
+    }
+    sav_path = NULL; // sav_buf goes out of scope; the saver keeps its own copy
+  }
+
+  shm_export_t shm;
+  if (shm_name && !shm_export_create(&shm, shm_name, nes.palette, err, sizeof(err))) {
+    fprintf(stderr, "shm: %s\n", err);
+    shm_name = NULL;
+  }
+
+  // From here on every exit goes through `out`, which flushes and closes the
+  // outputs opened above (trace, profile, video dump, shm, battery save).
+  int status = 0;
+  filter_t filter;
+  bool use_filter = false;
+#ifndef NES_NO_SDL
+  bool sdl_up = false;
+  SDL_Window *win = NULL;
+  SDL_Renderer *ren = NULL;
+  SDL_Texture *tex = NULL;
+#endif
+
+  // Netplay: both peers start from power-on, before any frame has run.
+  netplay_t netplay;
+  if (netplay_spec) {
+    if (netplay_player != 1 && netplay_player != 2) {
+      fprintf(stderr, "netplay: --netplay-player must be 1 or 2\n");
+      netplay_spec = NULL;
+    } else if (!open_netplay(&netplay, &nes, netplay_spec, netplay_player - 1, netplay_delay)) {
+      netplay_spec = NULL;
+    }
+    if (!netplay_spec) {
+      status = 1;
+      goto out;
+    }
+  }
+
+  // Upscaling filters: the band threads start with the first filter used (at
+  // startup with --filter, or when F first switches away from none).
+  use_filter = filter_kind != FILTER_NONE;
+  if (use_filter && !filter_init(&filter, filter_threads, nes.palette, err, sizeof(err))) {
+    fprintf(stderr, "filter: %s\n", err);
+    use_filter = false;
+    filter_kind = FILTER_NONE;
+  }
+
   if (headless) {
-    uint32_t h = 0, last_h = 0;
-    int same_h = 0;
+    uint32_t h = 0;
+    uint32_t *filter_out = NULL;
+    int filter_pitch = filter_width(filter_kind) * (int)sizeof(uint32_t);
+    if (use_filter) {
+      filter_out = (uint32_t *)malloc((size_t)filter_pitch * (size_t)filter_height(filter_kind));
+      if (!filter_out) {
+        fprintf(stderr, "filter: out of memory\n");
+        filter_free(&filter);
+        use_filter = false;
+      }
+    }
     int frames_done = 0;
+    freeze_detector_t freeze;
+    freeze_init(&freeze, 180);
+    double run_start = now_sec();
     for (int frame = 0; frame < headless_frames; frame++) {
       uint8_t pad = forced_pad;
       if (tap_start_frames > 0 && frame < tap_start_frames) pad |= (1 << 3);
       if (tap_a_frames > 0 && frame < tap_a_frames) pad |= (1 << 0);
       if (tap_b_frames > 0 && frame < tap_b_frames) pad |= (1 << 1);
-      nes.pad1_state = pad;
-      if (nes.pad_strobe) nes.pad1_shift = nes.pad1_state;
-      (void)nes_run_frame(&nes, 200000);
-      h = fnv1a32(nes.ppu.framebuffer, sizeof(nes.ppu.framebuffer));
-      if (frame > 0 && h == last_h) same_h++; else same_h = 0;
-      last_h = h;
+      if (netplay_spec) {
+        if (!netplay_run_frame(&netplay, &nes, pad, err, sizeof(err))) {
+          fprintf(stderr, "netplay: %s\n", err);
+          break;
+        }
+      } else {
+        nes_set_pad(&nes, 0, pad);
+        (void)nes_run_frame(&nes, 200000);
+      }
+      if (video_path) (void)video_dump_frame(&video, &nes.ppu);
+      if (shm_name) shm_export_publish(&shm, &nes);
+      if (use_sram) sram_poll(&sram, &nes.cart);
+      if (use_filter && !filter_run(&filter, filter_kind, nes.ppu.pixel_index, nes.ppu.line_emphasis, filter_out, filter_pitch)) {
+        fprintf(stderr, "filter: out of memory\n");
+        break;
+      }
       frames_done = frame + 1;
-      if (detect_freeze && same_h > 180) {
-        fprintf(stderr, "freeze suspected: framebuffer hash stable for %d frames\n", same_h);
+      if (detect_freeze && freeze_frame(&freeze, (struct nes *)&nes)) {
+        freeze_report(&freeze, stderr);
         break;
       }
     }
+    if (netplay_spec) {
+      // A final rollback may redraw the last frame.
+      finish_netplay(&netplay, &nes, true);
+      netplay_spec = NULL;
+    }
+    if (nes.ppu.raster) {
+      // Wait for the last frame so the hash matches a single-threaded run.
+      (void)nes_set_raster_thread(&nes, false, NULL, 0);
+    }
+    h = fnv1a32(nes.ppu.framebuffer, PPU_PIXELS * sizeof(uint32_t));
     printf("frames=%d framebuffer_fnv1a32=%08x\n", frames_done, h);
+    if (use_filter) {
+      size_t size = (size_t)filter_pitch * (size_t)filter_height(filter_kind);
+      printf("filter=%s filter_fnv1a32=%08x\n", filter_name(filter_kind), fnv1a32(filter_out, size));
+      free(filter_out);
+    }
+    if (report_fps) {
+      // Startup: from main() to the first frame (ROM load, cheats, sinks).
+      double run_time = now_sec() - run_start;
+      double fps = run_time > 0 ? frames_done / run_time : 0.0;
+      printf("startup_ms=%.2f run_s=%.3f frames_per_sec=%.1f realtime=%.2fx\n",
+             (run_start - start_time) * 1000.0, run_time, fps, fps / (39375000.0 / 655171.0));
+    }
     if (debug) {
       fprintf(stderr, "cpu_pc=%04x cpu_cycles=%llu ppu_sl=%d ppu_dot=%d mask=%02x status=%02x s0y=%u s0x=%u\n",
               nes.cpu.pc, (unsigned long long)nes.cpu.cycles,
               nes.ppu.scanline, nes.ppu.dot,
               nes.ppu.reg_mask, nes.ppu.reg_status,
               nes.ppu.oam[0], nes.ppu.oam[3]);
-      fprintf(stderr, "nmi_count=%llu\n", (unsigned long long)nes.dbg_nmi_count);
+      fprintf(stderr, "nmi_count=%llu idle_cycles=%llu\n", (unsigned long long)nes.dbg_nmi_count,
+              (unsigned long long)nes.dbg_idle_cycles);
       fprintf(stderr, "ppu_w=%d ppu_t=%04x ppu_v=%04x scroll_next=%u,%u render_ctrl_next=%02x\n",
               nes.ppu.w ? 1 : 0, nes.ppu.t, nes.ppu.v,
               nes.ppu.scroll_x_next, nes.ppu.scroll_y_next,
               nes.ppu.render_ctrl_next);
       fprintf(stderr, "fb0=%08x\n", nes.ppu.framebuffer[0]);
     }
-    nes_free(&nes);
-    return 0;
+    goto out;
   }
 
+#ifdef NES_NO_SDL
+  (void)unthrottled; // headless runs are never throttled
+  status = 2;        // not reached: this build only runs headless
+#else
   SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0) {
     fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
-    nes_free(&nes);
-    return 1;
+    status = 1;
+    goto out;
   }
+  sdl_up = true;
 
-  SDL_Window *win = SDL_CreateWindow("nes (mapper0)", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 256 * 3, 240 * 3, SDL_WINDOW_RESIZABLE);
+  win = SDL_CreateWindow("nes (mapper0)", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 256 * 3, 240 * 3, SDL_WINDOW_RESIZABLE);
   if (!win) {
     fprintf(stderr, "SDL_CreateWindow failed: %s\n", SDL_GetError());
-    nes_free(&nes);
-    SDL_Quit();
-    return 1;
+    status = 1;
+    goto out;
   }
   // Prefer software renderer for compatibility (e.g. VMs).
-  SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_SOFTWARE);
+  ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_SOFTWARE);
   if (!ren) ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
   if (!ren) {
     fprintf(stderr, "SDL_CreateRenderer failed: %s\n", SDL_GetError());
-    nes_free(&nes);
-    SDL_DestroyWindow(win);
-    SDL_Quit();
-    return 1;
+    status = 1;
+    goto out;
   }
 
-  SDL_Texture *tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 256, 240);
+  // The texture has the filter's output size; the renderer only has to
+  // scale it by the rest of the window size.
+  tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                          filter_width(filter_kind), filter_height(filter_kind));
   if (!tex) {
     fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
-    nes_free(&nes);
-    SDL_DestroyRenderer(ren);
-    SDL_DestroyWindow(win);
-    SDL_Quit();
-    return 1;
+    status = 1;
+    goto out;
   }
   SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_NONE);
   SDL_RenderSetLogicalSize(ren, 256, 240);
   SDL_RenderSetIntegerScale(ren, SDL_TRUE);
 
-  // Warm up a couple frames so init code that waits for vblank can run.
-  (void)nes_run_frame(&nes, 200000);
-  (void)nes_run_frame(&nes, 200000);
+  // Warm up a couple frames so init code that waits for vblank can run
+  // (not in netplay, where every frame must go through the session).
+  if (!netplay_spec) {
+    (void)nes_run_frame(&nes, 200000);
+    (void)nes_run_frame(&nes, 200000);
+  }
 
   bool running = true;
   const double target_fps = 60.0;
@@ -178,17 +556,72 @@ int main(int argc, char **argv) {
     while (SDL_PollEvent(&e)) {
       if (e.type == SDL_QUIT) running = false;
       if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) running = false;
-      if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_r) nes_reset(&nes);
+      // A local reset would desync the peer.
+      if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_r && !netplay_spec) nes_reset(&nes);
+      if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f) {
+        filter_kind_t next = (filter_kind_t)((filter_kind + 1) % FILTER_COUNT);
+        if (!use_filter) {
+          use_filter = filter_init(&filter, filter_threads, nes.palette, err, sizeof(err));
+          if (!use_filter) {
+            fprintf(stderr, "filter: %s\n", err);
+            continue;
+          }
+        }
+        SDL_Texture *t = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                           filter_width(next), filter_height(next));
+        if (t) {
+          SDL_DestroyTexture(tex);
+          tex = t;
+          SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_NONE);
+          filter_kind = next;
+          fprintf(stderr, "filter: %s\n", filter_name(filter_kind));
+        } else {
+          fprintf(stderr, "SDL_CreateTexture failed: %s\n", SDL_GetError());
+        }
+      }
     }
 
     const uint8_t *keys = SDL_GetKeyboardState(NULL);
-    nes.pad1_state = (uint8_t)(pack_controller_state(keys) | forced_pad);
-    if (nes.pad_strobe) nes.pad1_shift = nes.pad1_state;
+    uint8_t pad = (uint8_t)(pack_controller_state(keys) | forced_pad);
+
+    // Draw straight into the streaming texture unless the shared-memory export
+    // needs the ARGB frame too (or the pitch/raster thread rule it out).
+    // Filters write the texture themselves from the index plane.
+    void *tex_pixels = NULL;
+    int tex_pitch = 0;
+    bool direct = false;
+    if (filter_kind == FILTER_NONE && !shm_name && SDL_LockTexture(tex, NULL, &tex_pixels, &tex_pitch) == 0) {
+      direct = nes_set_frame_output(&nes, (uint32_t *)tex_pixels, tex_pitch);
+      if (!direct) SDL_UnlockTexture(tex);
+    }
 
     // Run until a frame becomes ready
-    (void)nes_run_frame(&nes, 200000);
+    if (netplay_spec) {
+      if (!netplay_run_frame(&netplay, &nes, pad, err, sizeof(err))) {
+        fprintf(stderr, "netplay: %s\n", err);
+        running = false;
+      }
+    } else {
+      nes_set_pad(&nes, 0, pad);
+      (void)nes_run_frame(&nes, 200000);
+    }
+    if (video_path) (void)video_dump_frame(&video, &nes.ppu);
+    if (shm_name) shm_export_publish(&shm, &nes);
+    if (use_sram) sram_poll(&sram, &nes.cart);
 
-    if (SDL_UpdateTexture(tex, NULL, nes.ppu.framebuffer, 256 * (int)sizeof(uint32_t)) != 0) {
+    if (direct) {
+      (void)nes_set_frame_output(&nes, NULL, 0);
+      SDL_UnlockTexture(tex);
+    } else if (filter_kind != FILTER_NONE) {
+      if (SDL_LockTexture(tex, NULL, &tex_pixels, &tex_pitch) == 0) {
+        bool drawn = filter_run(&filter, filter_kind, nes.ppu.pixel_index, nes.ppu.line_emphasis,
+                                (uint32_t *)tex_pixels, tex_pitch);
+        SDL_UnlockTexture(tex);
+        if (!drawn) fprintf(stderr, "filter: out of memory for %s\n", filter_name(filter_kind));
+      } else {
+        fprintf(stderr, "SDL_LockTexture failed: %s\n", SDL_GetError());
+      }
+    } else if (SDL_UpdateTexture(tex, NULL, nes.ppu.framebuffer, 256 * (int)sizeof(uint32_t)) != 0) {
       fprintf(stderr, "SDL_UpdateTexture failed: %s\n", SDL_GetError());
     }
     SDL_RenderClear(ren);
@@ -212,10 +645,25 @@ int main(int argc, char **argv) {
     }
   }
 
+#endif
+
+out:
+  if (trace_path) save_trace(&trace, trace_path);
+  if (profile_path) save_profile(&profile, profile_path);
+  if (video_path) finish_video_dump(&video, video_path);
+  if (shm_name) shm_export_destroy(&shm);
+  if (use_sram) finish_sram(&sram);
+  if (netplay_spec) finish_netplay(&netplay, &nes, false);
+  if (use_filter) {
+    filter_report(&filter, stderr);
+    filter_free(&filter);
+  }
   nes_free(&nes);
-  SDL_DestroyTexture(tex);
-  SDL_DestroyRenderer(ren);
-  SDL_DestroyWindow(win);
-  SDL_Quit();
-  return 0;
+#ifndef NES_NO_SDL
+  if (tex) SDL_DestroyTexture(tex);
+  if (ren) SDL_DestroyRenderer(ren);
+  if (win) SDL_DestroyWindow(win);
+  if (sdl_up) SDL_Quit();
+#endif
+  return status;
 }
@@ -1,5 +1,8 @@
 #include "nes.h"
+#include "raster.h"
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static uint16_t mirror_nametable_addr(nes_t *n, uint16_t ppu_addr) {
@@ -65,9 +68,7 @@ static void ppu_bus_write(nes_t *n, uint16_t addr, uint8_t v) {
   n->ppu.palette[pal] = (uint8_t)(v & 0x3F);
 }
 
-bool nes_load(nes_t *n, const char *rom_path, char *err, size_t err_cap) {
-  memset(n, 0, sizeof(*n));
-  if (!ines_load(&n->cart, rom_path, err, err_cap)) return false;
+static bool nes_init_loaded(nes_t *n, char *err, size_t err_cap) {
   if (n->cart.info.mapper != 0) {
     // Mapper 0 only in this first version.
     cart_free(&n->cart);
@@ -76,39 +77,120 @@ bool nes_load(nes_t *n, const char *rom_path, char *err, size_t err_cap) {
     }
     return false;
   }
+  n->icache = (cpu6502_icache_t *)malloc(sizeof(*n->icache));
+  if (!n->icache) {
+    cart_free(&n->cart);
+    if (err && err_cap) snprintf(err, err_cap, "oom instruction cache");
+    return false;
+  }
+  // All output planes in one block (see PPU_FRAME_BYTES), so frame outputs can be swapped.
+  n->frame_block = (uint32_t *)malloc(PPU_FRAME_BYTES);
+  if (!n->frame_block) {
+    cart_free(&n->cart);
+    free(n->icache);
+    n->icache = NULL;
+    if (err && err_cap) snprintf(err, err_cap, "oom framebuffer");
+    return false;
+  }
+  ppu_set_frame_block(&n->ppu, n->frame_block);
+  palette_default(n->palette);
+  n->ppu.rgb = n->palette;
+  cpu6502_icache_build(n->icache, (struct nes *)n);
   nes_reset(n);
   return true;
 }
 
+bool nes_load(nes_t *n, const char *rom_path, char *err, size_t err_cap) {
+  memset(n, 0, sizeof(*n));
+  if (!ines_load(&n->cart, rom_path, err, err_cap)) return false;
+  return nes_init_loaded(n, err, err_cap);
+}
+
+bool nes_load_mem(nes_t *n, const uint8_t *rom, size_t rom_size, char *err, size_t err_cap) {
+  memset(n, 0, sizeof(*n));
+  if (!ines_load_mem(&n->cart, rom, rom_size, err, err_cap)) return false;
+  return nes_init_loaded(n, err, err_cap);
+}
+
+bool nes_load_owned(nes_t *n, uint8_t *image, size_t size, char *err, size_t err_cap) {
+  memset(n, 0, sizeof(*n));
+  if (!ines_load_owned(&n->cart, image, size, err, err_cap)) return false;
+  return nes_init_loaded(n, err, err_cap);
+}
+
 void nes_free(nes_t *n) {
   if (!n) return;
+  (void)nes_set_raster_thread(n, false, NULL, 0);
+  free(n->cheats);
+  n->cheats = NULL;
   cart_free(&n->cart);
+  free(n->icache);
+  n->icache = NULL;
+  free(n->frame_block);
+  n->frame_block = NULL;
+  n->ppu.framebuffer = NULL;
+  n->ppu.pixel_index = NULL;
+  n->ppu.line_emphasis = NULL;
+}
+
+bool nes_set_frame_output(nes_t *n, uint32_t *pixels, int pitch) {
+  if (!pixels) {
+    if (!n->ppu.raster) n->ppu.framebuffer = n->frame_block;
+    return true;
+  }
+  if (pitch != 256 * (int)sizeof(uint32_t) || n->ppu.raster) return false;
+  // Only the ARGB plane moves; the index and emphasis planes stay in the owned block.
+  n->ppu.framebuffer = pixels;
+  return true;
+}
+
+void nes_set_palette(nes_t *n, const uint32_t rgb[PALETTE_SIZE]) {
+  memcpy(n->palette, rgb, sizeof(n->palette));
 }
 
 void nes_reset(nes_t *n) {
   memset(n->ram, 0, sizeof(n->ram));
   ppu_reset(&n->ppu);
-  n->pad1_state = 0;
-  n->pad1_shift = 0;
+  memset(n->pad_state, 0, sizeof(n->pad_state));
+  memset(n->pad_shift, 0, sizeof(n->pad_shift));
   n->pad_strobe = false;
   n->last_bus = 0;
   n->cpu_stall = 0;
   n->dbg_nmi_count = 0;
+  cpu6502_icache_flush_ram(n->icache);
   cpu6502_reset(&n->cpu, (struct nes *)n);
+  n->ppu_synced_cycles = n->cpu.cycles;
+}
+
+// Ticks the PPU up to the start of the CPU instruction currently executing.
+static void ppu_sync(nes_t *n) {
+  n->cpu_block_break = true;
+  while (n->ppu_synced_cycles < n->cpu.cycles) {
+    ppu_tick(&n->ppu, (struct nes *)n);
+    ppu_tick(&n->ppu, (struct nes *)n);
+    ppu_tick(&n->ppu, (struct nes *)n);
+    n->ppu_synced_cycles++;
+  }
 }
 
-static uint8_t cart_cpu_read(nes_t *n, uint16_t addr) {
-  // Mapper 0 (NROM): $8000-$FFFF maps to PRG ROM (16KB or 32KB)
-  if (addr < 0x8000) return 0;
+static uint8_t cart_cpu_read(const nes_t *n, uint16_t addr) {
+  // Mapper 0 (NROM): $6000-$7FFF is PRG RAM, $8000-$FFFF maps to PRG ROM (16KB or 32KB)
+  if (addr < 0x6000) return 0;
+  if (addr < 0x8000) return n->cart.prg_ram[addr & 0x1FFF];
   uint32_t prg_size = n->cart.info.prg_rom_size;
   uint32_t offset = (uint32_t)(addr - 0x8000);
   if (prg_size == 16u * 1024u) offset %= (16u * 1024u);
-  return n->cart.prg_rom[offset % prg_size];
+  uint8_t v = n->cart.prg_rom[offset % prg_size];
+  if (NES_UNLIKELY(n->cheats != NULL) && cheat_page_patched(n->cheats, addr)) v = cheat_patch_rom(n->cheats, addr, v);
+  return v;
 }
 
 static void cart_cpu_write(nes_t *n, uint16_t addr, uint8_t v) {
-  // NROM ignores writes
-  (void)n; (void)addr; (void)v;
+  // NROM ignores writes to ROM
+  if (addr >= 0x6000 && addr < 0x8000) {
+    n->cart.prg_ram[addr & 0x1FFF] = v;
+    n->cart.prg_ram_dirty |= 1u << ((addr >> 8) & 0x1F);
+  }
 }
 
 uint8_t nes_cpu_read(nes_t *n, uint16_t addr) {
@@ -116,19 +198,19 @@ uint8_t nes_cpu_read(nes_t *n, uint16_t addr) {
   if (addr < 0x2000) {
     v = n->ram[addr & 0x07FF];
   } else if (addr < 0x4000) {
+    ppu_sync(n);
     v = ppu_cpu_read(&n->ppu, (struct nes *)n, (uint16_t)(0x2000 | (addr & 7)));
-  } else if (addr == 0x4016) {
-    // controller 1
+  } else if (addr == 0x4016 || addr == 0x4017) {
+    // controllers 1 and 2
+    int port = addr & 1;
     if (n->pad_strobe) {
-      v = (uint8_t)(0x40 | (n->pad1_state & 1));
+      v = (uint8_t)(0x40 | (n->pad_state[port] & 1));
     } else {
-      v = (uint8_t)(0x40 | (n->pad1_shift & 1));
+      v = (uint8_t)(0x40 | (n->pad_shift[port] & 1));
       // Shift in 1s (after 8 reads, controller returns 1s on hardware).
-      n->pad1_shift = (uint8_t)((n->pad1_shift >> 1) | 0x80);
+      n->pad_shift[port] = (uint8_t)((n->pad_shift[port] >> 1) | 0x80);
     }
-  } else if (addr == 0x4017) {
-    v = 0x40;
-  } else if (addr >= 0x8000) {
+  } else if (addr >= 0x6000) {
     v = cart_cpu_read(n, addr);
   } else {
     // APU / IO not implemented
@@ -138,17 +220,75 @@ uint8_t nes_cpu_read(nes_t *n, uint16_t addr) {
   return v;
 }
 
+uint8_t nes_cpu_peek(const nes_t *n, uint16_t addr) {
+  if (addr < 0x2000) return n->ram[addr & 0x07FF];
+  if (addr >= 0x6000) return cart_cpu_read(n, addr);
+  return 0;
+}
+
+void nes_cpu_poke(nes_t *n, uint16_t addr, uint8_t v) {
+  if (addr < 0x2000) {
+    n->ram[addr & 0x07FF] = v;
+    cpu6502_icache_ram_write(n->icache, addr);
+  } else if (addr >= 0x6000 && addr < 0x8000) {
+    cart_cpu_write(n, addr, v);
+  }
+}
+
+void nes_set_pad(nes_t *n, int port, uint8_t buttons) {
+  if (port < 0 || port > 1) return;
+  n->pad_state[port] = buttons;
+  // While strobe is high the shift register follows the live buttons.
+  if (n->pad_strobe) n->pad_shift[port] = buttons;
+}
+
+void nes_ppu_position(const nes_t *n, int *scanline, int *dot) {
+  const uint64_t frame_dots = 262 * 341;
+  uint64_t lag = (n->cpu.cycles - n->ppu_synced_cycles) * 3;
+  uint64_t pos = ((uint64_t)(n->ppu.scanline + 1) * 341 + (uint64_t)n->ppu.dot + lag) % frame_dots;
+  *scanline = (int)(pos / 341) - 1;
+  *dot = (int)(pos % 341);
+}
+
+// OAM DMA source page when reading it has no side effects (RAM, PRG RAM and
+// unpatched PRG ROM), so it can be copied directly; NULL for I/O pages.
+static const uint8_t *dma_page(const nes_t *n, uint16_t base) {
+  if (base < 0x2000) return &n->ram[base & 0x0700];
+  if (base < 0x6000) return NULL;
+  if (base < 0x8000) return &n->cart.prg_ram[base & 0x1F00];
+  if (NES_UNLIKELY(n->cheats != NULL) && cheat_page_patched(n->cheats, base)) return NULL;
+  uint32_t prg_size = n->cart.info.prg_rom_size;
+  uint32_t offset = (uint32_t)(base - 0x8000);
+  if (prg_size == 16u * 1024u) offset %= (16u * 1024u);
+  offset %= prg_size;
+  return offset + 256u <= prg_size ? &n->cart.prg_rom[offset] : NULL;
+}
+
 void nes_cpu_write(nes_t *n, uint16_t addr, uint8_t v) {
   n->last_bus = v;
   if (addr < 0x2000) {
     n->ram[addr & 0x07FF] = v;
+    cpu6502_icache_ram_write(n->icache, addr);
   } else if (addr < 0x4000) {
+    // VRAM uploads with rendering off leave the PPU behind and keep the block
+    // going (see ppu_data_write_quiet).
+    if ((addr & 7) == 7 && ppu_data_write_quiet(&n->ppu, (struct nes *)n, v)) return;
+    ppu_sync(n);
     ppu_cpu_write(&n->ppu, (struct nes *)n, (uint16_t)(0x2000 | (addr & 7)), v);
   } else if (addr == 0x4014) {
     // OAMDMA: copy 256 bytes from CPU page to OAM
+    ppu_sync(n);
     uint16_t base = (uint16_t)v << 8;
-    for (int i = 0; i < 256; i++) {
-      n->ppu.oam[(uint8_t)(n->ppu.oam_addr + i)] = nes_cpu_read(n, (uint16_t)(base + (uint16_t)i));
+    const uint8_t *src = dma_page(n, base);
+    if (src) {
+      uint8_t start = n->ppu.oam_addr;
+      memcpy(&n->ppu.oam[start], src, 256u - start);
+      memcpy(n->ppu.oam, src + (256u - start), start);
+      n->last_bus = src[255];
+    } else {
+      for (int i = 0; i < 256; i++) {
+        n->ppu.oam[(uint8_t)(n->ppu.oam_addr + i)] = nes_cpu_read(n, (uint16_t)(base + (uint16_t)i));
+      }
     }
     // CPU is stalled; PPU continues to run during this time.
     // Real hardware: 513 or 514 cycles depending on alignment.
@@ -158,26 +298,131 @@ void nes_cpu_write(nes_t *n, uint16_t addr, uint8_t v) {
     bool prev = n->pad_strobe;
     n->pad_strobe = strobe;
     // Latch on 1, and also on falling edge 1->0 (common pattern: write 1 then 0).
-    if (strobe || (prev && !strobe)) n->pad1_shift = n->pad1_state;
-  } else if (addr >= 0x8000) {
+    if (strobe || (prev && !strobe)) memcpy(n->pad_shift, n->pad_state, sizeof(n->pad_shift));
+  } else if (addr >= 0x6000) {
     cart_cpu_write(n, addr, v);
   } else {
     // APU not implemented
   }
 }
 
+// Idle loops. A short ROM loop that only loads, compares and branches on RAM,
+// ROM or $2002 (classified in cpu6502.c) and comes back to its head with the
+// same registers and flags will do exactly the same pass again until
+// something outside it changes: an interrupt, or for $2002 polls a PPUSTATUS
+// change. Two identical passes in a row are enough; after that whole passes
+// are skipped by advancing the cycle counter, up to the end of the current
+// block (so interrupts land on the same instruction) or, for polls, up to the
+// last read that still sees the same status. The PPU then catches up as usual.
+static int idle_fast_forward(nes_t *n, uint64_t end, int steps, int max_steps) {
+  cpu6502_t *c = &n->cpu;
+  nes_idle_t *s = &n->idle;
+  n->cpu_idle_hint = false;
+  uint16_t cls = c->pc >= 0x8000 ? n->icache->idle[c->pc & 0x7FFF] : 0;
+  int count = cls & CPU6502_IDLE_COUNT_MASK;
+  if (count == 0 || c->nmi_pending || n->cpu_stall > 0 || (c->irq_pending && !(c->p & 0x04)) ||
+      n->trace != NULL || n->profile != NULL) {
+    s->valid = false;
+    return 0;
+  }
+  bool reads_ppu = (cls & CPU6502_IDLE_READS_PPU) != 0;
+  uint8_t p = cpu6502_get_p(c);
+  bool one_pass = s->valid && s->head == c->pc && steps - s->steps == count && s->nmi_count == n->dbg_nmi_count;
+  bool same = one_pass && s->a == c->a && s->x == c->x && s->y == c->y && s->sp == c->sp && s->p == p &&
+              (!reads_ppu || (s->status == n->ppu.reg_status && c->cycles <= s->event_cycle));
+  if (!same) {
+    if (one_pass && !reads_ppu) {
+      // Nothing outside a RAM-only loop changes while it runs, so a pass
+      // that changed the registers means it never settles.
+      n->icache->idle[c->pc & 0x7FFF] = CPU6502_IDLE_CHECKED;
+      s->valid = false;
+      return 0;
+    }
+    s->valid = true;
+    s->head = c->pc;
+    s->a = c->a;
+    s->x = c->x;
+    s->y = c->y;
+    s->sp = c->sp;
+    s->p = p;
+    s->status = n->ppu.reg_status;
+    s->steps = steps;
+    s->cycles = c->cycles;
+    s->nmi_count = n->dbg_nmi_count;
+    // A read at cycle t has ticked the PPU 3 * (t - now) dots.
+    if (reads_ppu) s->event_cycle = c->cycles + (uint64_t)(ppu_dots_until_status_change(&n->ppu) / 3);
+    return 0;
+  }
+
+  uint64_t pass = c->cycles - s->cycles;
+  uint64_t limit = end;
+  if (reads_ppu && s->event_cycle < limit) limit = s->event_cycle;
+  uint64_t k = limit > c->cycles ? (limit - c->cycles) / pass : 0;
+  uint64_t k_steps = (uint64_t)(max_steps - steps) / (uint64_t)count;
+  if (k > k_steps) k = k_steps;
+  c->cycles += k * pass;
+  n->dbg_idle_cycles += k * pass;
+  s->cycles = c->cycles;
+  s->steps = steps + (int)(k * (uint64_t)count);
+  if (k) ppu_sync(n);
+  return (int)(k * (uint64_t)count);
+}
+
 bool nes_run_frame(nes_t *n, int max_cpu_steps) {
   n->ppu.frame_ready = false;
-  for (int i = 0; i < max_cpu_steps; i++) {
-    int cpu_cycles = cpu6502_step(&n->cpu, (struct nes *)n);
-    for (int c = 0; c < cpu_cycles * 3; c++) {
-      ppu_tick(&n->ppu, (struct nes *)n);
-    }
+  n->idle.valid = false;
+  if (NES_UNLIKELY(n->cheats != NULL)) cheat_apply_ram((struct nes *)n);
+  for (int i = 0; i < max_cpu_steps;) {
+    // Run the CPU ahead of the PPU in blocks. A block never extends past the
+    // instruction during which vblank starts, so the NMI and frame boundary land
+    // exactly where per-instruction ticking would put them.
+    int budget = ppu_dots_until_vblank(&n->ppu) / 3 + 1;
+    uint64_t end = n->cpu.cycles + (uint64_t)budget;
+    i += cpu6502_run(&n->cpu, (struct nes *)n, budget, max_cpu_steps - i);
+    ppu_sync(n);
     if (n->ppu.frame_ready) return true;
+    if (NES_UNLIKELY(n->cpu_idle_hint)) {
+      i += idle_fast_forward(n, end, i, max_cpu_steps);
+      if (n->ppu.frame_ready) return true;
+    }
   }
   return false;
 }
 
+int nes_run_cycles(nes_t *n, uint64_t cycles) {
+  uint64_t end = n->cpu.cycles + cycles;
+  int frames = 0;
+  int steps = 0;
+  n->ppu.frame_ready = false;
+  n->idle.valid = false;
+  while (n->cpu.cycles < end) {
+    // Same blocking as nes_run_frame, additionally clipped to the requested end.
+    uint64_t budget = (uint64_t)(ppu_dots_until_vblank(&n->ppu) / 3 + 1);
+    if (budget > end - n->cpu.cycles) budget = end - n->cpu.cycles;
+    uint64_t block_end = n->cpu.cycles + budget;
+    steps += cpu6502_run(&n->cpu, (struct nes *)n, (int)budget, INT_MAX);
+    ppu_sync(n);
+    if (n->ppu.frame_ready) {
+      frames++;
+      n->ppu.frame_ready = false;
+      n->idle.valid = false;
+    } else if (NES_UNLIKELY(n->cpu_idle_hint)) {
+      steps += idle_fast_forward(n, block_end, steps, INT_MAX);
+      if (n->ppu.frame_ready) {
+        frames++;
+        n->ppu.frame_ready = false;
+        n->idle.valid = false;
+      }
+    }
+    if (steps > INT_MAX / 2) {
+      steps = 0;
+      n->idle.valid = false;
+    }
+  }
+  n->ppu.frame_ready = frames > 0;
+  return frames;
+}
+
 // Exposed for PPU implementation:
 uint8_t nes_ppu_bus_read(struct nes *nn, uint16_t addr) { return ppu_bus_read((nes_t *)nn, addr); }
 void nes_ppu_bus_write(struct nes *nn, uint16_t addr, uint8_t v) { ppu_bus_write((nes_t *)nn, addr, v); }
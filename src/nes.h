@@ -3,10 +3,26 @@
 #include "ines.h"
 #include "cpu6502.h"
 #include "ppu.h"
+#include "trace.h"
+#include "profile.h"
+#include "cheat.h"
+#include "palette.h"
+
+// The last pass through an idle loop, kept to compare with the next one.
+typedef struct {
+  bool valid;
+  uint16_t head;
+  uint8_t a, x, y, sp, p, status;
+  int steps;            // run-loop step count at the head
+  uint64_t cycles;
+  uint64_t nmi_count;
+  uint64_t event_cycle; // $2002 polls: reads up to here still see `status`
+} nes_idle_t;
 
 typedef struct nes {
   cart_t cart;
   cpu6502_t cpu;
+  cpu6502_icache_t *icache;
   ppu_t ppu;
 
   uint8_t ram[2048];
@@ -14,24 +30,71 @@ typedef struct nes {
   // CPU stalls (e.g., OAMDMA) in CPU cycles
   int cpu_stall;
 
-  // controller
-  uint8_t pad1_state;
-  uint8_t pad1_shift;
+  // The PPU runs behind the CPU and is caught up lazily: ppu_synced_cycles is
+  // the CPU cycle count the PPU has been ticked to. PPU/DMA register accesses
+  // sync it and end the current CPU block (cpu_block_break).
+  uint64_t ppu_synced_cycles;
+  bool cpu_block_break;
+  // A branch just closed a pass through a candidate idle loop (see nes.c).
+  bool cpu_idle_hint;
+  nes_idle_t idle;
+
+  // controllers ($4016 = port 0, $4017 = port 1)
+  uint8_t pad_state[2];
+  uint8_t pad_shift[2];
   bool pad_strobe;
 
   // APU/IO open bus-ish
   uint8_t last_bus;
 
+  // The frame output block (PPU_FRAME_BYTES) the machine owns. ppu.framebuffer
+  // points elsewhere while a frame output is set (nes_set_frame_output).
+  uint32_t *frame_block;
+  // ppu.rgb: the built-in palette unless replaced with nes_set_palette().
+  uint32_t palette[PALETTE_SIZE];
+
   // Debug counters
   uint64_t dbg_nmi_count;
+  uint64_t dbg_idle_cycles; // CPU cycles fast-forwarded through idle loops (not saved)
+
+  // Optional instruction trace and guest profiler (NULL = off)
+  trace_t *trace;
+  profile_t *profile;
+
+  // Active cheats (NULL = none)
+  cheat_set_t *cheats;
 } nes_t;
 
 bool nes_load(nes_t *n, const char *rom_path, char *err, size_t err_cap);
+// Borrows `rom` (uncompressed .nes image) for the lifetime of the machine.
+bool nes_load_mem(nes_t *n, const uint8_t *rom, size_t rom_size, char *err, size_t err_cap);
+// Takes ownership of a malloc'd .nes/.gz/.zip image.
+bool nes_load_owned(nes_t *n, uint8_t *image, size_t size, char *err, size_t err_cap);
 void nes_reset(nes_t *n);
 void nes_free(nes_t *n);
 
 uint8_t nes_cpu_read(nes_t *n, uint16_t addr);
 void nes_cpu_write(nes_t *n, uint16_t addr, uint8_t v);
+// Side-effect-free read for debuggers/tracers (RAM, PRG RAM and ROM; I/O reads as 0).
+uint8_t nes_cpu_peek(const nes_t *n, uint16_t addr);
+// Side-effect-free write to CPU RAM or PRG RAM (other addresses are ignored).
+void nes_cpu_poke(nes_t *n, uint16_t addr, uint8_t v);
+// Button state for controller `port` (0 = player 1, 1 = player 2), bit order as read: A, B, Select, Start, Up, Down, Left, Right.
+void nes_set_pad(nes_t *n, int port, uint8_t buttons);
+// PPU position at the current CPU cycle, including ticks the PPU has not run yet.
+void nes_ppu_position(const nes_t *n, int *scanline, int *dot);
+// Fast PPU mode only: draw scanlines on a worker thread while the next frame
+// is emulated. ppu.framebuffer then always holds the previous frame.
+bool nes_set_raster_thread(nes_t *n, bool on, char *err, size_t err_cap);
+// Draws the ARGB pixels of the following frames straight into `pixels` (e.g. a
+// locked streaming texture) instead of ppu.framebuffer; the internal buffer
+// is not updated meanwhile. Needs a pitch of 256 * 4 bytes and no raster
+// thread, otherwise returns false and keeps the internal buffer. NULL
+// switches back.
+bool nes_set_frame_output(nes_t *n, uint32_t *pixels, int pitch);
+// Replaces the output palette (see palette.h) from the next pixel drawn on;
+// frames already in the framebuffer keep their colours.
+void nes_set_palette(nes_t *n, const uint32_t rgb[PALETTE_SIZE]);
 
 // Internal: PPU bus callbacks (used by ppu.c)
 uint8_t nes_ppu_bus_read(struct nes *n, uint16_t addr);
@@ -39,3 +102,12 @@ void nes_ppu_bus_write(struct nes *n, uint16_t addr, uint8_t v);
 
 // runs until a frame is ready; returns true on frame
 bool nes_run_frame(nes_t *n, int max_cpu_steps);
+// runs at least `cycles` CPU cycles (stops at the end of the instruction that
+// crosses it); returns the number of frames completed meanwhile
+int nes_run_cycles(nes_t *n, uint64_t cycles);
+
+// Save states: a versioned, field-by-field little-endian snapshot of the
+// machine (not the ROM). Loading rejects states taken from a different ROM.
+size_t nes_state_size(const nes_t *n);
+bool nes_save_state(const nes_t *n, uint8_t *buf, size_t cap, size_t *out_size);
+bool nes_load_state(nes_t *n, const uint8_t *buf, size_t size, char *err, size_t err_cap);
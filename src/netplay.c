@@ -0,0 +1,290 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netplay.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Packets (little-endian), both start with "NP1" and a type byte:
+//   'H' hello: u32 rom crc, u8 player port
+//   'I' input: u32 rom crc, u32 ack (we hold your inputs for frames < ack),
+//              u32 first frame, u8 count, count input bytes
+// Every input packet repeats all inputs the peer has not acknowledged, so a
+// lost packet is covered by the next one and there are no retransmit timers.
+enum { PKT_HELLO = 'H', PKT_INPUT = 'I', PKT_MAX_INPUTS = 64 };
+
+#define NETPLAY_RESEND_MS 10
+#define NETPLAY_TIMEOUT_MS 5000
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void send_packet(netplay_t *np, const uint8_t *buf, size_t len) {
+  // Best effort: a full socket buffer or ICMP error is the same as a lost packet.
+  (void)sendto(np->fd, buf, len, 0, (const struct sockaddr *)&np->peer, sizeof(np->peer));
+}
+
+static void send_hello(netplay_t *np) {
+  uint8_t pkt[9] = { 'N', 'P', '1', PKT_HELLO };
+  put_u32(pkt + 4, np->rom_crc);
+  pkt[8] = (uint8_t)np->local_port;
+  send_packet(np, pkt, sizeof(pkt));
+}
+
+static void send_inputs(netplay_t *np) {
+  uint8_t pkt[17 + PKT_MAX_INPUTS] = { 'N', 'P', '1', PKT_INPUT };
+  uint32_t first = np->peer_ack;
+  if (np->local_count - first > PKT_MAX_INPUTS) first = np->local_count - PKT_MAX_INPUTS;
+  uint32_t count = np->local_count - first;
+  put_u32(pkt + 4, np->rom_crc);
+  put_u32(pkt + 8, np->remote_count);
+  put_u32(pkt + 12, first);
+  pkt[16] = (uint8_t)count;
+  for (uint32_t i = 0; i < count; i++) pkt[17 + i] = np->local_input[(first + i) % NETPLAY_RING];
+  send_packet(np, pkt, 17 + count);
+}
+
+static void receive_inputs(netplay_t *np, const uint8_t *pkt, size_t len) {
+  if (len < 17 || get_u32(pkt + 4) != np->rom_crc) return;
+  uint32_t ack = get_u32(pkt + 8);
+  uint32_t first = get_u32(pkt + 12);
+  uint32_t count = pkt[16];
+  if (len < 17 + (size_t)count) return;
+  if (ack > np->peer_ack && ack <= np->local_count) np->peer_ack = ack;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t f = first + i;
+    if (f < np->remote_count) continue;
+    if (f > np->remote_count) break; // gap: the peer resends from our ack
+    if (f >= np->frame + NETPLAY_RING / 2) break;
+    uint8_t v = pkt[17 + i];
+    np->remote_input[f % NETPLAY_RING] = v;
+    np->remote_count++;
+    if (f < np->frame && np->used_remote[f % NETPLAY_RING] != v && f < np->rollback_from) np->rollback_from = f;
+  }
+}
+
+// Drains the socket; returns true if a hello arrived (used by the handshake).
+static bool poll_socket(netplay_t *np, bool *bad_hello) {
+  bool hello = false;
+  uint8_t pkt[256];
+  for (;;) {
+    ssize_t len = recv(np->fd, pkt, sizeof(pkt), 0);
+    if (len < 0) break; // EAGAIN, or an ICMP error from a peer not up yet
+    if (len < 4 || memcmp(pkt, "NP1", 3) != 0) continue;
+    if (pkt[3] == PKT_HELLO && len >= 9) {
+      if (get_u32(pkt + 4) != np->rom_crc || pkt[8] == np->local_port) *bad_hello = true;
+      else hello = true;
+    } else if (pkt[3] == PKT_INPUT) {
+      if (len >= 8 && get_u32(pkt + 4) == np->rom_crc) hello = true;
+      receive_inputs(np, pkt, (size_t)len);
+    }
+  }
+  return hello;
+}
+
+static void wait_readable(netplay_t *np, int ms) {
+  struct pollfd pfd = { np->fd, POLLIN, 0 };
+  (void)poll(&pfd, 1, ms);
+}
+
+bool netplay_open(netplay_t *np, const nes_t *n, int player, int delay, int bind_port, const char *peer,
+                  uint32_t timeout_ms, char *err, size_t err_cap) {
+  memset(np, 0, sizeof(*np));
+  np->fd = -1;
+  np->local_port = player;
+  np->delay = delay < 0 ? 0 : (delay > NETPLAY_MAX_DELAY ? NETPLAY_MAX_DELAY : delay);
+  np->rom_crc = n->cart.info.crc32;
+  np->rollback_from = UINT32_MAX;
+
+  char host[256];
+  const char *colon = strrchr(peer, ':');
+  if (!colon || colon == peer || (size_t)(colon - peer) >= sizeof(host)) {
+    if (err && err_cap) snprintf(err, err_cap, "peer must be host:port, got '%s'", peer);
+    return false;
+  }
+  memcpy(host, peer, (size_t)(colon - peer));
+  host[colon - peer] = 0;
+  struct addrinfo hints, *res = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  int rc = getaddrinfo(host, colon + 1, &hints, &res);
+  if (rc != 0 || !res) {
+    if (err && err_cap) snprintf(err, err_cap, "%s: %s", peer, gai_strerror(rc));
+    return false;
+  }
+  memcpy(&np->peer, res->ai_addr, sizeof(np->peer));
+  freeaddrinfo(res);
+
+  np->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons((uint16_t)bind_port);
+  if (np->fd < 0 || bind(np->fd, (const struct sockaddr *)&local, sizeof(local)) != 0 ||
+      fcntl(np->fd, F_SETFL, O_NONBLOCK) != 0) {
+    if (err && err_cap) snprintf(err, err_cap, "udp port %d: %s", bind_port, strerror(errno));
+    netplay_close(np);
+    return false;
+  }
+
+  np->state_size = nes_state_size(n);
+  np->snapshots = (uint8_t *)malloc(np->state_size * (NETPLAY_MAX_ROLLBACK + 1));
+  if (!np->snapshots) {
+    if (err && err_cap) snprintf(err, err_cap, "out of memory");
+    netplay_close(np);
+    return false;
+  }
+  // Inputs for the first `delay` frames are neutral on both sides.
+  np->local_count = (uint32_t)np->delay;
+
+  uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000ull;
+  for (;;) {
+    bool bad = false;
+    send_hello(np);
+    if (poll_socket(np, &bad)) break;
+    if (bad) {
+      if (err && err_cap) snprintf(err, err_cap, "peer runs a different ROM or the same player number");
+      netplay_close(np);
+      return false;
+    }
+    if (now_ns() > deadline) {
+      if (err && err_cap) snprintf(err, err_cap, "no answer from %s", peer);
+      netplay_close(np);
+      return false;
+    }
+    wait_readable(np, 50);
+  }
+  // The peer may have missed our earlier hellos; our input packets count too.
+  send_hello(np);
+  return true;
+}
+
+static uint8_t *snapshot_slot(netplay_t *np, uint32_t frame) {
+  return np->snapshots + (size_t)(frame % (NETPLAY_MAX_ROLLBACK + 1)) * np->state_size;
+}
+
+// Sets both controllers for `frame`: known remote input, else the last known one.
+static void apply_inputs(netplay_t *np, nes_t *n, uint32_t frame) {
+  uint8_t remote = 0;
+  if (frame < np->remote_count) remote = np->remote_input[frame % NETPLAY_RING];
+  else if (np->remote_count > 0) remote = np->remote_input[(np->remote_count - 1) % NETPLAY_RING];
+  np->used_remote[frame % NETPLAY_RING] = remote;
+  nes_set_pad(n, np->local_port, np->local_input[frame % NETPLAY_RING]);
+  nes_set_pad(n, np->local_port ^ 1, remote);
+}
+
+static bool rollback(netplay_t *np, nes_t *n, bool render_last, char *err, size_t err_cap) {
+  uint32_t from = np->rollback_from;
+  np->rollback_from = UINT32_MAX;
+  uint64_t t0 = now_ns();
+  if (!nes_load_state(n, snapshot_slot(np, from), np->state_size, err, err_cap)) return false;
+  // Frames before np->frame are never displayed, so skip drawing them.
+  bool skip = n->ppu.skip_render;
+  n->ppu.skip_render = true;
+  for (uint32_t f = from; f < np->frame; f++) {
+    if (f != from) (void)nes_save_state(n, snapshot_slot(np, f), np->state_size, NULL);
+    if (render_last && f + 1 == np->frame) n->ppu.skip_render = skip;
+    apply_inputs(np, n, f);
+    (void)nes_run_frame(n, 200000);
+  }
+  n->ppu.skip_render = skip;
+  uint32_t depth = np->frame - from;
+  np->stats.rollbacks++;
+  np->stats.resim_frames += depth;
+  if (depth > np->stats.max_depth) np->stats.max_depth = depth;
+  np->stats.resim_ns += now_ns() - t0;
+  return true;
+}
+
+bool netplay_run_frame(netplay_t *np, nes_t *n, uint8_t local_buttons, char *err, size_t err_cap) {
+  np->local_input[np->local_count % NETPLAY_RING] = local_buttons;
+  np->local_count++;
+  send_inputs(np);
+  bool bad = false;
+  (void)poll_socket(np, &bad);
+
+  // Past the rollback window: wait for the peer instead of predicting further.
+  if (np->frame >= np->remote_count + NETPLAY_MAX_ROLLBACK) {
+    np->stats.stalls++;
+    uint64_t deadline = now_ns() + (uint64_t)NETPLAY_TIMEOUT_MS * 1000000ull;
+    while (np->frame >= np->remote_count + NETPLAY_MAX_ROLLBACK) {
+      if (now_ns() > deadline) {
+        if (err && err_cap) snprintf(err, err_cap, "peer stopped sending inputs at frame %u", np->remote_count);
+        return false;
+      }
+      wait_readable(np, NETPLAY_RESEND_MS);
+      send_inputs(np);
+      (void)poll_socket(np, &bad);
+    }
+  }
+
+  if (np->rollback_from < np->frame && !rollback(np, n, false, err, err_cap)) return false;
+
+  uint64_t t0 = now_ns();
+  (void)nes_save_state(n, snapshot_slot(np, np->frame), np->state_size, NULL);
+  uint64_t t1 = now_ns();
+  apply_inputs(np, n, np->frame);
+  (void)nes_run_frame(n, 200000);
+  np->stats.snapshot_ns += t1 - t0;
+  np->stats.frame_ns += now_ns() - t1;
+  np->stats.frames++;
+  np->frame++;
+  return true;
+}
+
+bool netplay_finish(netplay_t *np, nes_t *n, uint32_t timeout_ms, char *err, size_t err_cap) {
+  uint64_t deadline = now_ns() + (uint64_t)timeout_ms * 1000000ull;
+  bool bad = false;
+  for (;;) {
+    (void)poll_socket(np, &bad);
+    // Send after receiving so the last packet carries our final ack.
+    send_inputs(np);
+    if (np->remote_count >= np->frame && np->peer_ack >= np->frame) break;
+    if (now_ns() > deadline) {
+      if (err && err_cap) snprintf(err, err_cap, "peer left before confirming frame %u", np->frame);
+      return false;
+    }
+    wait_readable(np, NETPLAY_RESEND_MS);
+  }
+  if (np->rollback_from < np->frame) return rollback(np, n, true, err, err_cap);
+  return true;
+}
+
+void netplay_report(const netplay_t *np, FILE *out) {
+  const netplay_stats_t *s = &np->stats;
+  fprintf(out, "netplay: %llu frames, %llu stalls, %llu rollbacks re-ran %llu frames (avg %.1f, max %llu)\n",
+          (unsigned long long)s->frames, (unsigned long long)s->stalls, (unsigned long long)s->rollbacks,
+          (unsigned long long)s->resim_frames, s->rollbacks ? (double)s->resim_frames / (double)s->rollbacks : 0.0,
+          (unsigned long long)s->max_depth);
+  fprintf(out, "netplay: %.1f us/frame rendered, %.1f us/frame re-run, %.1f us/snapshot (%zu bytes)\n",
+          s->frames ? (double)s->frame_ns / 1000.0 / (double)s->frames : 0.0,
+          s->resim_frames ? (double)s->resim_ns / 1000.0 / (double)s->resim_frames : 0.0,
+          s->frames ? (double)s->snapshot_ns / 1000.0 / (double)s->frames : 0.0, np->state_size);
+}
+
+void netplay_close(netplay_t *np) {
+  if (np->fd >= 0) close(np->fd);
+  np->fd = -1;
+  free(np->snapshots);
+  np->snapshots = NULL;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "common.h"
+#include "nes.h"
+#include <netinet/in.h>
+#include <stdio.h>
+
+// Two-player rollback netplay over UDP. Both peers run the same ROM from
+// power-on in lockstep by frame number; each sends its own controller input
+// (delayed by `delay` frames) and predicts the other's as "same as last
+// known". When a real input arrives that differs from the prediction, the
+// machine is restored from the snapshot taken before that frame and the
+// frames since are re-run with rendering skipped.
+enum {
+  NETPLAY_RING = 128,        // input history (frames)
+  NETPLAY_MAX_ROLLBACK = 12, // never run further ahead of the peer than this
+  NETPLAY_MAX_DELAY = 8,
+};
+
+typedef struct {
+  uint64_t frames;          // frames shown
+  uint64_t rollbacks;       // mispredictions corrected
+  uint64_t resim_frames;    // frames re-run during rollbacks
+  uint64_t max_depth;       // longest rollback (frames)
+  uint64_t stalls;          // frames that had to wait for the peer
+  uint64_t frame_ns;        // time in normal (rendered) frames
+  uint64_t resim_ns;        // time in re-simulated frames, including state loads
+  uint64_t snapshot_ns;     // time saving per-frame snapshots
+} netplay_stats_t;
+
+typedef struct netplay {
+  int fd;
+  struct sockaddr_in peer;
+  int local_port;        // controller driven by this side (0 or 1)
+  int delay;
+  uint32_t rom_crc;
+
+  uint32_t frame;        // next frame to run
+  uint32_t local_count;  // local inputs known for frames [0, local_count)
+  uint32_t remote_count; // remote inputs known for frames [0, remote_count)
+  uint32_t peer_ack;     // peer has our inputs for frames [0, peer_ack)
+  uint8_t local_input[NETPLAY_RING];
+  uint8_t remote_input[NETPLAY_RING];
+  uint8_t used_remote[NETPLAY_RING]; // remote input each frame actually ran with
+  uint32_t rollback_from;            // earliest mispredicted frame, or UINT32_MAX
+
+  size_t state_size;
+  uint8_t *snapshots; // NETPLAY_MAX_ROLLBACK + 1 states, taken before each frame
+
+  netplay_stats_t stats;
+} netplay_t;
+
+// `bind_port`: local UDP port; `peer`: "host:port". Blocks until the peer
+// answers (or `timeout_ms` passes) and checks both sides loaded the same ROM.
+bool netplay_open(netplay_t *np, const nes_t *n, int player, int delay, int bind_port, const char *peer,
+                  uint32_t timeout_ms, char *err, size_t err_cap);
+// Runs one frame with `local_buttons` for this player, rolling back first
+// if earlier predictions were wrong. Fails if the peer stops answering.
+bool netplay_run_frame(netplay_t *np, nes_t *n, uint8_t local_buttons, char *err, size_t err_cap);
+// At the end of a session: waits (up to `timeout_ms`) until both sides hold
+// each other's inputs for every frame run, then rolls back once more if
+// needed, so both machines end in the same state. False on timeout.
+bool netplay_finish(netplay_t *np, nes_t *n, uint32_t timeout_ms, char *err, size_t err_cap);
+// Rollback counts and costs: time per rendered frame vs per re-run frame.
+void netplay_report(const netplay_t *np, FILE *out);
+void netplay_close(netplay_t *np);
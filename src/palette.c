@@ -0,0 +1,118 @@
+#include "palette.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t builtin_rgb[64] = {
+  0xFF666666,0xFF002A88,0xFF1412A7,0xFF3B00A4,0xFF5C007E,0xFF6E0040,0xFF6C0600,0xFF561D00,
+  0xFF333500,0xFF0B4800,0xFF005200,0xFF004F08,0xFF00404D,0xFF000000,0xFF000000,0xFF000000,
+  0xFFADADAD,0xFF155FD9,0xFF4240FF,0xFF7527FE,0xFFA01ACC,0xFFB71E7B,0xFFB53120,0xFF994E00,
+  0xFF6B6D00,0xFF388700,0xFF0C9300,0xFF008F32,0xFF007C8D,0xFF000000,0xFF000000,0xFF000000,
+  0xFFFFFEFF,0xFF64B0FF,0xFF9290FF,0xFFC676FF,0xFFF36AFF,0xFFFE6ECC,0xFFFE8170,0xFFEA9E22,
+  0xFFBCBE00,0xFF88D800,0xFF5CE430,0xFF45E082,0xFF48CDDE,0xFF4F4F4F,0xFF000000,0xFF000000,
+  0xFFFFFEFF,0xFFC0DFFF,0xFFD3D2FF,0xFFE8C8FF,0xFFFBC2FF,0xFFFEC4EA,0xFFFECCC5,0xFFF7D8A5,
+  0xFFE4E594,0xFFCFEF96,0xFFBDF4AB,0xFFB3F3CC,0xFFB5EBF2,0xFFB8B8B8,0xFF000000,0xFF000000,
+};
+
+// Emphasis dims the signal by about a quarter while it is active.
+#define EMPHASIS_ATTENUATION 0.746
+
+// Emphasis rows for a table whose first 64 entries are set: each emphasis
+// bit keeps its own channel and dims the other two (all three dim everything).
+static void derive_emphasis(uint32_t *t) {
+  for (int e = 1; e < 8; e++) {
+    int keep[3] = {0, 0, 0}; // R, G, B
+    for (int c = 0; c < 3; c++) keep[c] = (e & (1 << c)) && e != 7;
+    for (int i = 0; i < 64; i++) {
+      uint32_t rgb = t[i], out = 0xFF000000u;
+      for (int c = 0; c < 3; c++) {
+        int shift = 16 - 8 * c;
+        int v = (int)((rgb >> shift) & 0xFF);
+        if (!keep[c]) v = (int)(v * EMPHASIS_ATTENUATION + 0.5);
+        out |= (uint32_t)v << shift;
+      }
+      t[(e << 6) | i] = out;
+    }
+  }
+}
+
+void palette_default(uint32_t out[PALETTE_SIZE]) {
+  memcpy(out, builtin_rgb, sizeof(builtin_rgb));
+  derive_emphasis(out);
+}
+
+void palette_ntsc_defaults(palette_ntsc_t *p) {
+  p->hue = 0.0;
+  p->saturation = 1.0;
+  p->contrast = 1.0;
+  p->brightness = 0.0;
+  p->gamma = 2.2;
+}
+
+// Does the square wave of `color` sit high during sample `phase` (0-11)?
+static bool in_color_phase(int color, int phase) {
+  return (color + phase) % 12 < 6;
+}
+
+static uint32_t to_byte(double v, double gamma) {
+  if (v <= 0.0) return 0;
+  v = pow(v, 2.2 / gamma) * 255.0 + 0.5;
+  return v >= 255.0 ? 255u : (uint32_t)v;
+}
+
+void palette_generate_ntsc(uint32_t out[PALETTE_SIZE], const palette_ntsc_t *p) {
+  // 2C02 output voltages for levels 0-3, low and high half of the colour wave.
+  static const double lo_levels[4] = {0.350, 0.518, 0.962, 1.550};
+  static const double hi_levels[4] = {1.094, 1.506, 1.962, 1.962};
+  const double black = 0.518, white = 1.962;
+  const double pi = 3.14159265358979323846;
+  double hue = (p->hue + 120.0) * pi / 180.0; // lines colour $x1 up with blue
+
+  for (int entry = 0; entry < PALETTE_SIZE; entry++) {
+    int color = entry & 0x0F, emphasis = entry >> 6;
+    int level = color < 0x0E ? (entry >> 4) & 3 : 1;
+    double lo = lo_levels[level], hi = hi_levels[level];
+    if (color == 0x00) lo = hi;
+    if (color > 0x0C) hi = lo;
+
+    double y = 0.0, i = 0.0, q = 0.0;
+    for (int phase = 0; phase < 12; phase++) {
+      double s = in_color_phase(color, phase) ? hi : lo;
+      if (((emphasis & 1) && in_color_phase(0x0C, phase)) || ((emphasis & 2) && in_color_phase(0x04, phase)) ||
+          ((emphasis & 4) && in_color_phase(0x08, phase)))
+        s *= EMPHASIS_ATTENUATION;
+      double v = (s - black) / (white - black);
+      double a = pi * phase / 6.0 + hue;
+      y += v;
+      i += v * cos(a);
+      q += v * sin(a);
+    }
+    y = y / 12.0 * p->contrast + p->brightness;
+    i = i / 12.0 * p->saturation;
+    q = q / 12.0 * p->saturation;
+
+    double r = y + 0.946882 * i + 0.623557 * q;
+    double g = y - 0.274788 * i - 0.635691 * q;
+    double b = y - 1.108545 * i + 1.709007 * q;
+    out[entry] = 0xFF000000u | to_byte(r, p->gamma) << 16 | to_byte(g, p->gamma) << 8 | to_byte(b, p->gamma);
+  }
+}
+
+bool palette_load(uint32_t out[PALETTE_SIZE], const char *path, char *err, size_t err_cap) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    if (err && err_cap) snprintf(err, err_cap, "cannot open palette %s", path);
+    return false;
+  }
+  uint8_t buf[PALETTE_SIZE * 3 + 1];
+  size_t n = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+  if (n != 64 * 3 && n != PALETTE_SIZE * 3) {
+    if (err && err_cap) snprintf(err, err_cap, "%s: a .pal file has 192 or 1536 bytes", path);
+    return false;
+  }
+  for (size_t e = 0; e < n / 3; e++)
+    out[e] = 0xFF000000u | (uint32_t)buf[e * 3] << 16 | (uint32_t)buf[e * 3 + 1] << 8 | buf[e * 3 + 2];
+  if (n == 64 * 3) derive_emphasis(out);
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "common.h"
+
+// Output palettes: 64 colours x 8 emphasis combinations. Entry
+// (emphasis << 6) | colour, where emphasis is PPUMASK bits 5-7 (red, green,
+// blue), so the PPU indexes a table with ((mask & 0xE0) << 1) | colour.
+enum { PALETTE_SIZE = 512 };
+
+// NTSC decoder settings for palette_generate_ntsc(). Defaults give the 2C02
+// signal levels decoded with a standard YIQ matrix.
+typedef struct {
+  double hue;        // degrees added to every colour phase
+  double saturation; // 1 = nominal
+  double contrast;   // 1 = nominal
+  double brightness; // added to luma, 0 = nominal
+  double gamma;      // display gamma the palette is corrected for (2.2 = none)
+} palette_ntsc_t;
+
+// The built-in colours (the table this emulator has always used), with the
+// emphasis rows derived by dimming the channels that are not emphasised.
+void palette_default(uint32_t out[PALETTE_SIZE]);
+
+void palette_ntsc_defaults(palette_ntsc_t *p);
+// Decodes the composite signal of every colour and emphasis combination:
+// 12 samples per colour cycle, emphasised phases attenuated as on the 2C02.
+void palette_generate_ntsc(uint32_t out[PALETTE_SIZE], const palette_ntsc_t *p);
+
+// Loads a .pal file: 192 bytes (64 RGB triples, emphasis rows derived as for
+// the built-in table) or 1536 bytes (all 512 entries).
+bool palette_load(uint32_t out[PALETTE_SIZE], const char *path, char *err, size_t err_cap);
@@ -1,28 +1,37 @@
 #include "ppu.h"
 #include "nes.h"
+#include "raster.h"
 #include <string.h>
 
 // Forward decls from nes.c for PPU bus access
 uint8_t nes_ppu_bus_read(struct nes *n, uint16_t addr);
 void nes_ppu_bus_write(struct nes *n, uint16_t addr, uint8_t v);
 
-static uint32_t nes_palette_rgb(uint8_t idx) {
-  // Simple hardcoded NTSC-ish palette (compact). Not perfect, but usable.
-  static const uint32_t pal[64] = {
-    0xFF666666,0xFF002A88,0xFF1412A7,0xFF3B00A4,0xFF5C007E,0xFF6E0040,0xFF6C0600,0xFF561D00,
-    0xFF333500,0xFF0B4800,0xFF005200,0xFF004F08,0xFF00404D,0xFF000000,0xFF000000,0xFF000000,
-    0xFFADADAD,0xFF155FD9,0xFF4240FF,0xFF7527FE,0xFFA01ACC,0xFFB71E7B,0xFFB53120,0xFF994E00,
-    0xFF6B6D00,0xFF388700,0xFF0C9300,0xFF008F32,0xFF007C8D,0xFF000000,0xFF000000,0xFF000000,
-    0xFFFFFEFF,0xFF64B0FF,0xFF9290FF,0xFFC676FF,0xFFF36AFF,0xFFFE6ECC,0xFFFE8170,0xFFEA9E22,
-    0xFFBCBE00,0xFF88D800,0xFF5CE430,0xFF45E082,0xFF48CDDE,0xFF4F4F4F,0xFF000000,0xFF000000,
-    0xFFFFFEFF,0xFFC0DFFF,0xFFD3D2FF,0xFFE8C8FF,0xFFFBC2FF,0xFFFEC4EA,0xFFFECCC5,0xFFF7D8A5,
-    0xFFE4E594,0xFFCFEF96,0xFFBDF4AB,0xFFB3F3CC,0xFFB5EBF2,0xFFB8B8B8,0xFF000000,0xFF000000,
-  };
-  return pal[idx & 0x3F];
+void ppu_set_frame_block(ppu_t *p, uint32_t *block) {
+  p->framebuffer = block;
+  p->pixel_index = (uint8_t *)(block + PPU_PIXELS);
+  p->line_emphasis = p->pixel_index + PPU_PIXELS;
 }
 
 void ppu_reset(ppu_t *p) {
+  ppu_render_mode_t mode = p->render_mode;
+  bool skip_render = p->skip_render;
+  uint32_t *framebuffer = p->framebuffer;
+  uint8_t *pixel_index = p->pixel_index;
+  uint8_t *line_emphasis = p->line_emphasis;
+  const uint32_t *rgb = p->rgb;
+  struct ppu_raster *raster = p->raster;
   memset(p, 0, sizeof(*p));
+  p->render_mode = mode;
+  p->skip_render = skip_render;
+  p->framebuffer = framebuffer;
+  p->pixel_index = pixel_index;
+  p->line_emphasis = line_emphasis;
+  p->rgb = rgb;
+  p->raster = raster;
+  if (framebuffer) memset(framebuffer, 0, PPU_PIXELS * sizeof(uint32_t));
+  if (pixel_index) memset(pixel_index, 0, PPU_PIXELS);
+  if (line_emphasis) memset(line_emphasis, 0, 240);
   p->reg_status = 0xA0; // power-up bits
   p->scanline = -1;
   p->dot = 0;
@@ -32,6 +41,14 @@ void ppu_reset(ppu_t *p) {
   p->scroll_y_next = 0;
   p->render_ctrl = 0;
   p->render_ctrl_next = 0;
+  if (raster) raster_record_sync(raster, p, NULL, 0);
+}
+
+void ppu_set_render_mode(ppu_t *p, ppu_render_mode_t mode) {
+  p->render_mode = mode;
+  p->render_ctrl = p->render_ctrl_next;
+  p->line_log_count = 0;
+  p->line_log_overflow = false;
 }
 
 uint8_t ppu_cpu_read(ppu_t *p, struct nes *nes, uint16_t addr) {
@@ -64,8 +81,47 @@ uint8_t ppu_cpu_read(ppu_t *p, struct nes *nes, uint16_t addr) {
   }
 }
 
+static ppu_view_t current_view(const ppu_t *p) {
+  ppu_view_t w = { p->reg_mask, p->render_ctrl, p->scroll_x, p->scroll_y };
+  return w;
+}
+
+static void apply_view(ppu_t *p, const ppu_view_t *w) {
+  p->reg_mask = w->mask;
+  p->render_ctrl = w->ctrl;
+  p->scroll_x = w->scroll_x;
+  p->scroll_y = w->scroll_y;
+}
+
+// Fast mode approximation of a mid-frame $2006 split: map the new v onto the
+// simplified scroll latches from the current position onwards.
+static void scroll_from_v(ppu_t *p) {
+  bool mid_line = p->dot >= 1 && p->dot <= 256;
+  int nt_x = (p->v >> 10) & 1;
+  int nt_y = (p->v >> 11) & 1;
+  int sx = (int)((p->v & 0x1F) << 3) + p->x - (mid_line ? p->dot - 1 : 0);
+  if (sx < 0) { sx += 256; nt_x ^= 1; }
+  int line = (p->dot <= 256) ? p->scanline : p->scanline + 1; // Y was already bumped at dot 256
+  int sy = (int)(((p->v >> 5) & 0x1F) << 3) + ((p->v >> 12) & 7) - line;
+  if (sy < 0) { sy += 240; nt_y ^= 1; }
+  p->scroll_x = (uint8_t)sx;
+  p->scroll_y = (uint8_t)sy;
+  p->render_ctrl = (uint8_t)((p->render_ctrl & 0xFC) | (nt_y << 1) | nt_x);
+  // t == v now: the dot-257 copy keeps this X origin for the following lines.
+  p->scroll_x_next = (uint8_t)(((p->t & 0x1F) << 3) | p->x);
+  p->render_ctrl_next = (uint8_t)((p->render_ctrl_next & 0xFC) | ((p->t >> 10) & 3));
+}
+
 void ppu_cpu_write(ppu_t *p, struct nes *nes, uint16_t addr, uint8_t v) {
   addr &= 7;
+  bool fast_visible = p->render_mode == PPU_RENDER_FAST && p->scanline >= 0 && p->scanline < 240;
+  bool log = fast_visible && p->dot >= 1 && p->dot <= 256;
+  ppu_line_write_t e;
+  if (log) {
+    e.dot = (uint16_t)p->dot;
+    e.has_mem = false;
+    e.before = current_view(p);
+  }
   switch (addr) {
     case 0: // PPUCTRL
       {
@@ -78,6 +134,9 @@ void ppu_cpu_write(ppu_t *p, struct nes *nes, uint16_t addr, uint8_t v) {
         }
       }
       p->t = (uint16_t)((p->t & 0xF3FF) | ((uint16_t)(v & 0x03) << 10));
+      // Pattern table and sprite size bits apply immediately; the nametable
+      // select goes through t and waits for the dot-257 copy.
+      if (fast_visible) p->render_ctrl = (uint8_t)((p->render_ctrl & 0x03) | (v & 0xFC));
       break;
     case 1: // PPUMASK
       p->reg_mask = v;
@@ -92,6 +151,7 @@ void ppu_cpu_write(ppu_t *p, struct nes *nes, uint16_t addr, uint8_t v) {
       if (!p->w) {
         p->scroll_x_next = v;
         p->x = (uint8_t)(v & 7);
+        if (fast_visible) p->scroll_x = (uint8_t)((p->scroll_x & 0xF8) | (v & 7)); // fine X is live
         p->t = (uint16_t)((p->t & 0xFFE0) | (v >> 3));
         p->w = true;
       } else {
@@ -109,60 +169,42 @@ void ppu_cpu_write(ppu_t *p, struct nes *nes, uint16_t addr, uint8_t v) {
         p->t = (uint16_t)((p->t & 0xFF00) | v);
         p->v = p->t;
         p->w = false;
+        if (fast_visible && (p->reg_mask & 0x18)) scroll_from_v(p);
       }
       break;
     case 7: { // PPUDATA
       uint16_t vaddr = p->v & 0x3FFF;
+      if (log) {
+        e.has_mem = true;
+        e.addr = vaddr;
+        e.mem_old = nes_ppu_bus_read(nes, vaddr);
+      }
       nes_ppu_bus_write(nes, vaddr, v);
+      if (p->raster) raster_record_write(p->raster, vaddr, v);
+      if (log) e.mem_new = nes_ppu_bus_read(nes, vaddr);
       p->v += (p->reg_ctrl & 0x04) ? 32 : 1;
     } break;
     default:
       break;
   }
-}
-
-static uint8_t ppu_get_bg_pixel(ppu_t *p, struct nes *nes, int x, int y, uint8_t *out_pal_index) {
-  bool show_bg = (p->reg_mask & 0x08) != 0;
-  if (!show_bg) { *out_pal_index = 0; return 0; }
-
-  // Simplified scroll based on $2005 writes.
-  int X = (x + (int)p->scroll_x) & 511; // 0..511
-  int Y = (y + (int)p->scroll_y) % 480; // 0..479
-  if (Y < 0) Y += 480;
-
-  int sx = X & 255;
-  int sy = Y % 240;
-  int tile_x = sx / 8;
-  int tile_y = sy / 8;
-  int fine_y = sy & 7;
-
-  int nt = (p->render_ctrl & 0x03);
-  if (X >= 256) nt ^= 1;
-  if (Y >= 240) nt ^= 2;
-  uint16_t base_nt = (uint16_t)(0x2000 + nt * 0x0400);
-  uint16_t base_pt = (p->render_ctrl & 0x10) ? 0x1000 : 0x0000;
 
-  uint16_t nt_addr = (uint16_t)(base_nt + tile_y * 32 + tile_x);
-  uint8_t tile = nes_ppu_bus_read(nes, nt_addr);
-
-  uint16_t at_addr = (uint16_t)(base_nt + 0x3C0 + (tile_y / 4) * 8 + (tile_x / 4));
-  uint8_t at = nes_ppu_bus_read(nes, at_addr);
-  int quadrant = ((tile_y & 2) ? 2 : 0) | ((tile_x & 2) ? 1 : 0);
-  uint8_t pal = 0;
-  switch (quadrant) {
-    case 0: pal = (uint8_t)(at & 0x03); break;
-    case 1: pal = (uint8_t)((at >> 2) & 0x03); break;
-    case 2: pal = (uint8_t)((at >> 4) & 0x03); break;
-    case 3: pal = (uint8_t)((at >> 6) & 0x03); break;
+  if (log) {
+    e.after = current_view(p);
+    if (!e.has_mem && memcmp(&e.before, &e.after, sizeof(e.before)) == 0) return;
+    if (p->line_log_count < PPU_LINE_LOG_SIZE) p->line_log[p->line_log_count++] = e;
+    else p->line_log_overflow = true;
   }
+}
 
-  uint16_t pt_addr = (uint16_t)(base_pt + tile * 16 + fine_y);
-  uint8_t lo = nes_ppu_bus_read(nes, pt_addr);
-  uint8_t hi = nes_ppu_bus_read(nes, (uint16_t)(pt_addr + 8));
-  int bit = 7 - (sx & 7);
-  uint8_t px = (uint8_t)((((hi >> bit) & 1) << 1) | ((lo >> bit) & 1));
-  *out_pal_index = pal;
-  return px;
+bool ppu_data_write_quiet(ppu_t *p, struct nes *nes, uint8_t v) {
+  // Lines drawn with rendering off only read the backdrop colour, so palette
+  // writes still go through the synced path.
+  uint16_t vaddr = p->v & 0x3FFF;
+  if ((p->reg_mask & 0x18) || vaddr >= 0x3F00) return false;
+  nes_ppu_bus_write(nes, vaddr, v);
+  if (p->raster) raster_record_write(p->raster, vaddr, v);
+  p->v += (p->reg_ctrl & 0x04) ? 32 : 1;
+  return true;
 }
 
 static void eval_sprites_for_scanline(ppu_t *p, int y) {
@@ -277,35 +319,207 @@ static uint8_t sprite0_pixel(ppu_t *p, struct nes *nes, int y, int x) {
   return px;
 }
 
-static void render_scanline(ppu_t *p, struct nes *nes, int y) {
-  for (int x = 0; x < 256; x++) {
-    uint8_t pal_index = 0;
-    uint8_t bg_px = ppu_get_bg_pixel(p, nes, x, y, &pal_index);
+// Sprite/background priority and palette lookup for one output pixel.
+// Returns true when an opaque sprite-0 pixel overlaps an opaque BG pixel.
+static bool output_pixel(ppu_t *p, struct nes *nes, int x, int y, uint8_t bg_px, uint8_t pal_index) {
+  uint8_t sp_pal = 0, sp_pri = 0;
+  bool sp0 = false;
+  uint8_t sp_px = sprite_pixel(p, nes, y, x, &sp_pal, &sp_pri, &sp0);
+
+  uint8_t color_idx = 0;
+  bool bg_opaque = (bg_px != 0) && ((p->reg_mask & 0x08) != 0);
+  bool sp_opaque = (sp_px != 0) && ((p->reg_mask & 0x10) != 0);
+
+  if (sp_opaque && (!bg_opaque || sp_pri == 0)) {
+    uint16_t pal_addr = (uint16_t)(0x3F10 + 1 + sp_pal * 4 + (sp_px - 1));
+    color_idx = nes_ppu_bus_read(nes, pal_addr) & 0x3F;
+  } else if (bg_opaque) {
+    uint16_t pal_addr = (uint16_t)(0x3F00 + 1 + pal_index * 4 + (bg_px - 1));
+    color_idx = nes_ppu_bus_read(nes, pal_addr) & 0x3F;
+  } else {
+    color_idx = p->palette[0] & 0x3F;
+  }
+  // Greyscale keeps only the luma column; emphasis picks the table row.
+  if (p->reg_mask & 0x01) color_idx &= 0x30;
+  if (x == 0) p->line_emphasis[y] = (uint8_t)(p->reg_mask >> 5);
+  p->framebuffer[y * 256 + x] = p->rgb[((p->reg_mask & 0xE0) << 1) | color_idx];
+  p->pixel_index[y * 256 + x] = color_idx;
+  return sp0 && sp_opaque && bg_opaque;
+}
+
+static void render_scanline(ppu_t *p, struct nes *nes, int y, int x0, int x1) {
+  // Simplified scroll based on $2005 writes. Nametable, attribute and pattern
+  // fetches are done once per 8-pixel tile.
+  bool show_bg = (p->reg_mask & 0x08) != 0;
+  int Y = (y + (int)p->scroll_y) % 480;
+  int sy = Y % 240;
+  int tile_y = sy / 8;
+  uint16_t base_pt = (p->render_ctrl & 0x10) ? 0x1000 : 0x0000;
+  uint8_t lo = 0, hi = 0, pal = 0;
+  for (int x = x0; x < x1; x++) {
+    int X = (x + (int)p->scroll_x) & 511;
+    if (show_bg && (x == x0 || (X & 7) == 0)) {
+      int tile_x = (X & 255) / 8;
+      int nt = (p->render_ctrl & 0x03);
+      if (X >= 256) nt ^= 1;
+      if (Y >= 240) nt ^= 2;
+      uint16_t base_nt = (uint16_t)(0x2000 + nt * 0x0400);
+      uint8_t tile = nes_ppu_bus_read(nes, (uint16_t)(base_nt + tile_y * 32 + tile_x));
+      uint8_t at = nes_ppu_bus_read(nes, (uint16_t)(base_nt + 0x3C0 + (tile_y / 4) * 8 + (tile_x / 4)));
+      int shift = ((tile_y & 2) ? 4 : 0) | ((tile_x & 2) ? 2 : 0);
+      pal = (uint8_t)((at >> shift) & 0x03);
+      uint16_t pt_addr = (uint16_t)(base_pt + tile * 16 + (sy & 7));
+      lo = nes_ppu_bus_read(nes, pt_addr);
+      hi = nes_ppu_bus_read(nes, (uint16_t)(pt_addr + 8));
+    }
+    uint8_t bg_px = 0;
+    if (show_bg) {
+      int bit = 7 - (X & 7);
+      bg_px = (uint8_t)((((hi >> bit) & 1) << 1) | ((lo >> bit) & 1));
+    }
     if (x < 8 && !(p->reg_mask & 0x02)) bg_px = 0;
+    (void)output_pixel(p, nes, x, y, bg_px, show_bg ? pal : 0);
+  }
+}
 
-    uint8_t sp_pal = 0, sp_pri = 0;
-    bool sp0 = false;
-    uint8_t sp_px = sprite_pixel(p, nes, y, x, &sp_pal, &sp_pri, &sp0);
+// Renders the current line at dot 257. Writes logged during the line are
+// undone to recover the state at dot 0, then replayed at their dots between
+// segments. Lines without mid-line writes render in a single batch.
+static void render_scanline_segments(ppu_t *p, struct nes *nes, int y) {
+  int n = p->line_log_count;
+  if (p->skip_render) {
+    // The logged writes are already applied; nothing to undo or replay.
+  } else if (p->raster) {
+    raster_record_line(p->raster, p, y);
+  } else if (n == 0 || p->line_log_overflow) {
+    render_scanline(p, nes, y, 0, 256);
+  } else {
+    for (int i = n - 1; i >= 0; i--) {
+      const ppu_line_write_t *e = &p->line_log[i];
+      if (e->has_mem) nes_ppu_bus_write(nes, e->addr, e->mem_old);
+      apply_view(p, &e->before);
+    }
+    int x = 0;
+    for (int i = 0; i < n; i++) {
+      const ppu_line_write_t *e = &p->line_log[i];
+      int x_end = e->dot - 1; // the pixel output on this dot already sees the write
+      if (x_end > x) {
+        render_scanline(p, nes, y, x, x_end);
+        x = x_end;
+      }
+      if (e->has_mem) nes_ppu_bus_write(nes, e->addr, e->mem_new);
+      apply_view(p, &e->after);
+    }
+    if (x < 256) render_scanline(p, nes, y, x, 256);
+  }
+  p->line_log_count = 0;
+  p->line_log_overflow = false;
+}
 
-    uint8_t color_idx = 0;
-    bool bg_opaque = (bg_px != 0) && ((p->reg_mask & 0x08) != 0);
-    bool sp_opaque = (sp_px != 0) && ((p->reg_mask & 0x10) != 0);
+void ppu_render_line(ppu_t *p, struct nes *nes, int y) { render_scanline_segments(p, nes, y); }
 
-    if (sp_opaque && (!bg_opaque || sp_pri == 0)) {
-      uint16_t pal_addr = (uint16_t)(0x3F10 + 1 + sp_pal * 4 + (sp_px - 1));
-      color_idx = nes_ppu_bus_read(nes, pal_addr) & 0x3F;
-    } else if (bg_opaque) {
-      uint16_t pal_addr = (uint16_t)(0x3F00 + 1 + pal_index * 4 + (bg_px - 1));
-      color_idx = nes_ppu_bus_read(nes, pal_addr) & 0x3F;
-    } else {
-      color_idx = p->palette[0] & 0x3F;
+// --- Accurate mode: loopy v/t scrolling with the hardware fetch pipeline ---
+
+static void increment_coarse_x(ppu_t *p) {
+  if ((p->v & 0x001F) == 31) {
+    p->v &= (uint16_t)~0x001F;
+    p->v ^= 0x0400;
+  } else {
+    p->v++;
+  }
+}
+
+static void increment_y(ppu_t *p) {
+  if ((p->v & 0x7000) != 0x7000) {
+    p->v += 0x1000;
+    return;
+  }
+  p->v &= (uint16_t)~0x7000;
+  int coarse_y = (p->v & 0x03E0) >> 5;
+  if (coarse_y == 29) {
+    coarse_y = 0;
+    p->v ^= 0x0800;
+  } else if (coarse_y == 31) {
+    coarse_y = 0;
+  } else {
+    coarse_y++;
+  }
+  p->v = (uint16_t)((p->v & ~0x03E0) | (coarse_y << 5));
+}
+
+static void load_bg_shifters(ppu_t *p) {
+  p->bg_shift_lo = (uint16_t)((p->bg_shift_lo & 0xFF00) | p->bg_next_lo);
+  p->bg_shift_hi = (uint16_t)((p->bg_shift_hi & 0xFF00) | p->bg_next_hi);
+  p->at_shift_lo = (uint16_t)((p->at_shift_lo & 0xFF00) | ((p->bg_next_attr & 1) ? 0xFF : 0x00));
+  p->at_shift_hi = (uint16_t)((p->at_shift_hi & 0xFF00) | ((p->bg_next_attr & 2) ? 0xFF : 0x00));
+}
+
+static void fetch_bg(ppu_t *p, struct nes *nes, int dot) {
+  p->bg_shift_lo <<= 1;
+  p->bg_shift_hi <<= 1;
+  p->at_shift_lo <<= 1;
+  p->at_shift_hi <<= 1;
+  switch ((dot - 1) & 7) {
+    case 0:
+      load_bg_shifters(p);
+      p->bg_next_tile = nes_ppu_bus_read(nes, (uint16_t)(0x2000 | (p->v & 0x0FFF)));
+      break;
+    case 2: {
+      uint16_t at_addr = (uint16_t)(0x23C0 | (p->v & 0x0C00) | ((p->v >> 4) & 0x38) | ((p->v >> 2) & 0x07));
+      uint8_t at = nes_ppu_bus_read(nes, at_addr);
+      int shift = ((p->v >> 4) & 4) | (p->v & 2);
+      p->bg_next_attr = (uint8_t)((at >> shift) & 3);
+    } break;
+    case 4:
+    case 6: {
+      uint16_t base_pt = (p->reg_ctrl & 0x10) ? 0x1000 : 0x0000;
+      uint16_t addr = (uint16_t)(base_pt + p->bg_next_tile * 16 + ((p->v >> 12) & 7));
+      if (((dot - 1) & 7) == 4) p->bg_next_lo = nes_ppu_bus_read(nes, addr);
+      else p->bg_next_hi = nes_ppu_bus_read(nes, (uint16_t)(addr + 8));
+    } break;
+    case 7:
+      increment_coarse_x(p);
+      break;
+    default:
+      break;
+  }
+}
+
+static void tick_accurate(ppu_t *p, struct nes *nes) {
+  int dot = p->dot;
+  bool visible = p->scanline >= 0 && p->scanline < 240;
+  bool rendering = (p->reg_mask & 0x18) != 0;
+  p->render_ctrl = p->reg_ctrl;
+
+  if (visible && dot == 0) eval_sprites_for_scanline(p, p->scanline);
+
+  if (rendering && (visible || p->scanline == -1)) {
+    if ((dot >= 2 && dot <= 257) || (dot >= 321 && dot <= 337)) fetch_bg(p, nes, dot);
+    if (dot == 256) increment_y(p);
+    if (dot == 257) {
+      load_bg_shifters(p);
+      p->v = (uint16_t)((p->v & ~0x041F) | (p->t & 0x041F));
     }
-    p->framebuffer[y * 256 + x] = nes_palette_rgb(color_idx);
+    if (p->scanline == -1 && dot >= 280 && dot <= 304) {
+      p->v = (uint16_t)((p->v & ~0x7BE0) | (p->t & 0x7BE0));
+    }
+  }
+
+  if (visible && dot >= 1 && dot <= 256) {
+    int x = dot - 1;
+    uint8_t bg_px = 0, pal_index = 0;
+    if ((p->reg_mask & 0x08) && (x >= 8 || (p->reg_mask & 0x02))) {
+      uint16_t mux = (uint16_t)(0x8000 >> p->x);
+      bg_px = (uint8_t)((((p->bg_shift_hi & mux) != 0) << 1) | ((p->bg_shift_lo & mux) != 0));
+      pal_index = (uint8_t)((((p->at_shift_hi & mux) != 0) << 1) | ((p->at_shift_lo & mux) != 0));
+    }
+    if (output_pixel(p, nes, x, p->scanline, bg_px, pal_index) && x != 255) p->reg_status |= 0x40;
   }
 }
 
-void ppu_tick(ppu_t *p, struct nes *nes) {
-  // Very simplified timing: render per scanline and set vblank/NMI at scanline 241.
+static void tick_fast(ppu_t *p, struct nes *nes) {
+  // Very simplified timing: render per scanline (at dot 257, in segments around
+  // mid-line register writes) and set vblank/NMI at scanline 241.
   // This is enough for some NROM games but not cycle-accurate.
   // Approximate NES scroll timing:
   // - Vertical scroll effectively latched at start of frame (pre-render).
@@ -315,39 +529,41 @@ void ppu_tick(ppu_t *p, struct nes *nes) {
     p->scroll_y = p->scroll_y_next;
     p->render_ctrl = p->render_ctrl_next;
   }
+  if (p->scanline >= 0 && p->scanline < 240 && p->dot == 0) {
+    eval_sprites_for_scanline(p, p->scanline);
+  }
+
   if (p->scanline >= 0 && p->scanline < 240 && p->dot == 257) {
+    render_scanline_segments(p, nes, p->scanline);
     p->scroll_x = p->scroll_x_next;
     p->render_ctrl = p->render_ctrl_next;
   }
 
-  if (p->scanline >= 0 && p->scanline < 240 && p->dot == 0) {
-    eval_sprites_for_scanline(p, p->scanline);
-    render_scanline(p, nes, p->scanline);
-  }
-
   // Sprite-0 hit timing: approximate at the correct dot position.
   if ((p->reg_status & 0x40) == 0 && p->scanline >= 0 && p->scanline < 240 && p->dot >= 1 && p->dot <= 256) {
     int x = p->dot - 1;
     if (!(x < 8 && (!(p->reg_mask & 0x02) || !(p->reg_mask & 0x04)))) {
-      uint8_t pal_index = 0;
-      uint8_t bg_px = ppu_get_bg_pixel(p, nes, x, p->scanline, &pal_index);
-      if (x < 8 && !(p->reg_mask & 0x02)) bg_px = 0;
       uint8_t s0 = sprite0_pixel(p, nes, p->scanline, x);
       if (s0 && (p->reg_mask & 0x08) && (p->reg_mask & 0x10)) {
-        // Best-effort: if BG pixel calculation is off (common with simplified scrolling),
-        // still allow sprite-0 hit when sprite-0's pixel is opaque. This keeps SMB-style
+        // Best-effort: the simplified scroll model can get the BG pixel wrong, so
+        // any opaque sprite-0 pixel counts as a hit. This keeps SMB-style
         // split-screen timing loops from deadlocking, while staying tied to the real
-        // sprite-0 dot/scanline.
-        (void)bg_px;
+        // sprite-0 dot/scanline. Accurate mode does the real BG/sprite overlap test.
         p->reg_status |= 0x40;
       }
     }
   }
+}
+
+void ppu_tick(ppu_t *p, struct nes *nes) {
+  if (p->render_mode == PPU_RENDER_ACCURATE) tick_accurate(p, nes);
+  else tick_fast(p, nes);
 
   if (p->scanline == 241 && p->dot == 1) {
     p->reg_status |= 0x80;
     if (p->reg_ctrl & 0x80) cpu6502_set_nmi(&((nes_t *)nes)->cpu);
     p->frame_ready = true;
+    if (p->raster) raster_end_frame(p->raster, p);
   }
 
   if (p->scanline == -1 && p->dot == 1) {
@@ -356,11 +572,74 @@ void ppu_tick(ppu_t *p, struct nes *nes) {
   }
 
   p->dot++;
+  // Accurate mode: odd frames skip the last pre-render dot while rendering.
+  if (p->scanline == -1 && p->dot == 340 && p->odd_frame &&
+      p->render_mode == PPU_RENDER_ACCURATE && (p->reg_mask & 0x18)) {
+    p->dot = 341;
+  }
   if (p->dot >= 341) {
     p->dot = 0;
     p->scanline++;
     if (p->scanline >= 261) {
       p->scanline = -1;
+      p->odd_frame = !p->odd_frame;
     }
   }
 }
+
+int ppu_dots_until_status_change(const ppu_t *p) {
+  const int frame_dots = 262 * 341;
+  int pos = (p->scanline + 1) * 341 + p->dot;
+  // Events at (scanline, dot) fire on the tick that starts there.
+  int vblank = (241 + 1) * 341 + 1 - pos;
+  int clear = 1 - pos;
+  if (vblank < 0) vblank += frame_dots;
+  if (clear < 0) clear += frame_dots;
+  int d = vblank < clear ? vblank : clear;
+
+  // Sprite 0 can only hit on its own lines (up to 16 of them).
+  if (!(p->reg_status & 0x40) && (p->reg_mask & 0x18) == 0x18) {
+    int top = p->oam[0] + 1;
+    int first = (top + 1) * 341, last = (top + 16 + 1) * 341;
+    if (top < 240) {
+      if (pos >= first && pos < last) return 0;
+      if (pos < first && first - pos < d) d = first - pos;
+    }
+  }
+
+  // Sprite overflow is re-evaluated at dot 0 of every visible line.
+  if (p->scanline < 240) {
+    int sprite_h = (p->reg_ctrl & 0x20) ? 16 : 8;
+    uint8_t count[240];
+    memset(count, 0, sizeof(count));
+    for (int i = 0; i < 64; i++) {
+      int top = p->oam[i * 4] + 1;
+      for (int y = top; y < top + sprite_h && y < 240; y++) count[y]++;
+    }
+    bool overflow = (p->reg_status & 0x20) != 0;
+    int y0 = p->scanline < 0 ? 0 : (p->dot == 0 ? p->scanline : p->scanline + 1);
+    for (int y = y0; y < 240; y++) {
+      int at = (y + 1) * 341 - pos;
+      if (at >= d) break;
+      if ((count[y] > 8) != overflow) {
+        d = at;
+        break;
+      }
+    }
+  }
+  return d;
+}
+
+int ppu_dots_until_vblank(const ppu_t *p) {
+  // Linear dot position within the 262-line frame, starting at the pre-render line.
+  const int frame_dots = 262 * 341;
+  const int vblank_pos = (241 + 1) * 341 + 1;
+  int pos = (p->scanline + 1) * 341 + p->dot;
+  int d = vblank_pos - pos;
+  if (d < 0) d += frame_dots;
+  if (p->render_mode == PPU_RENDER_ACCURATE && p->scanline == -1 && p->dot < 340 && p->odd_frame &&
+      (p->reg_mask & 0x18)) {
+    d--;
+  }
+  return d;
+}
@@ -2,8 +2,40 @@
 #include "common.h"
 
 struct nes;
+struct ppu_raster;
+
+typedef enum {
+  PPU_RENDER_FAST = 0,     // whole scanline rendered at dot 0 from latched scroll
+  PPU_RENDER_ACCURATE = 1, // dot-by-dot loopy v/t rendering with BG shift registers
+} ppu_render_mode_t;
+
+// Registers the fast renderer reads while drawing a scanline.
+typedef struct {
+  uint8_t mask, ctrl, scroll_x, scroll_y;
+} ppu_view_t;
+
+// A CPU write that landed while the fast renderer's current scanline was being
+// displayed: the view before/after it plus an optional VRAM/palette byte.
+typedef struct {
+  uint16_t dot;
+  uint16_t addr;
+  bool has_mem;
+  uint8_t mem_old, mem_new;
+  ppu_view_t before, after;
+} ppu_line_write_t;
+
+enum { PPU_LINE_LOG_SIZE = 32, PPU_PIXELS = 256 * 240 };
+// One frame output block: the ARGB plane, the index plane, then one emphasis
+// byte per line (see ppu_set_frame_block()).
+enum { PPU_FRAME_BYTES = PPU_PIXELS * (sizeof(uint32_t) + 1) + 240 };
 
 typedef struct ppu {
+  ppu_render_mode_t render_mode; // kept across ppu_reset()
+  // Fast mode only: skip drawing scanlines (timing, sprite 0 and all
+  // CPU-visible state are unchanged). Used when re-simulating frames
+  // that are never shown. Kept across ppu_reset(), not saved in states.
+  bool skip_render;
+
   uint8_t reg_ctrl;
   uint8_t reg_mask;
   uint8_t reg_status;
@@ -30,11 +62,31 @@ typedef struct ppu {
   uint8_t render_ctrl;      // active for current scanline
   uint8_t render_ctrl_next; // last written
 
+  // scanline and dot are kept apart on purpose: when they are adjacent the
+  // compiler fuses the (scanline, dot) tests into one 64-bit load, which
+  // cannot be forwarded from the 32-bit dot++ store of the previous tick.
   int scanline; // -1..260
-  int dot;      // 0..340
   bool frame_ready;
+  bool odd_frame;
+  int dot;      // 0..340
+
+  // Accurate mode background pipeline
+  uint16_t bg_shift_lo, bg_shift_hi;
+  uint16_t at_shift_lo, at_shift_hi;
+  uint8_t bg_next_tile, bg_next_attr, bg_next_lo, bg_next_hi;
 
-  uint32_t framebuffer[256 * 240]; // RGBA8888
+  // Frame output, PPU_PIXELS each (allocated by the owner, kept across ppu_reset()).
+  uint32_t *framebuffer; // RGBA8888
+  uint8_t *pixel_index;  // same frame as master palette indices (0-63), greyscale applied
+  uint8_t *line_emphasis; // per line: PPUMASK bits 5-7 (>> 5) as of its first pixel
+  // Output palette, 512 entries (see palette.h); owned by the machine.
+  const uint32_t *rgb;
+
+  // Fast mode: writes during dots 1-256 of the current visible scanline, so it
+  // can be rendered in segments at dot 257 (undo all, then redo one by one).
+  ppu_line_write_t line_log[PPU_LINE_LOG_SIZE];
+  uint8_t line_log_count;
+  bool line_log_overflow;
 
   // cached sprite eval for current scanline (simplified)
   uint8_t scan_spr_count;
@@ -43,9 +95,28 @@ typedef struct ppu {
   uint8_t scan_spr_tile[8];
   uint8_t scan_spr_attr[8];
   uint8_t scan_spr_x[8];
+
+  // Fast mode: when set, scanlines are drawn on a worker thread one frame
+  // behind (see raster.h). Kept across ppu_reset().
+  struct ppu_raster *raster;
 } ppu_t;
 
 void ppu_reset(ppu_t *p);
+void ppu_set_render_mode(ppu_t *p, ppu_render_mode_t mode);
 uint8_t ppu_cpu_read(ppu_t *p, struct nes *nes, uint16_t addr);
 void ppu_cpu_write(ppu_t *p, struct nes *nes, uint16_t addr, uint8_t v);
+// $2007 write that may run ahead of the PPU: with rendering off, a nametable
+// or CHR write changes nothing the PPU draws or reports before it is caught
+// up. Returns false (and does nothing) when the write needs a synced PPU.
+bool ppu_data_write_quiet(ppu_t *p, struct nes *nes, uint8_t v);
 void ppu_tick(ppu_t *p, struct nes *nes); // 1 PPU cycle
+// Draws visible line `y` from the current view, sprite list and write log
+// (fast mode), then clears the log. Used by the raster worker.
+void ppu_render_line(ppu_t *p, struct nes *nes, int y);
+int ppu_dots_until_vblank(const ppu_t *p); // ticks before the one that raises vblank/NMI
+// Ticks before the first one that may change PPUSTATUS (vblank set, the
+// pre-render clear, a sprite-0 hit or a sprite-overflow change), assuming
+// no register writes meanwhile. May be early, never late.
+int ppu_dots_until_status_change(const ppu_t *p);
+// Points the frame output at a PPU_FRAME_BYTES block.
+void ppu_set_frame_block(ppu_t *p, uint32_t *block);
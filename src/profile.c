@@ -0,0 +1,185 @@
+#include "profile.h"
+#include "nes.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum { HASH_SLOTS = PROFILE_MAX_NODES * 2 };
+
+bool profile_init(profile_t *p, uint32_t period) {
+  memset(p, 0, sizeof(*p));
+  p->pc_samples = (uint32_t *)calloc(0x10000, sizeof(uint32_t));
+  p->nodes = (profile_node_t *)calloc(PROFILE_MAX_NODES, sizeof(profile_node_t));
+  p->node_hash = (uint32_t *)calloc(HASH_SLOTS, sizeof(uint32_t));
+  if (!p->pc_samples || !p->nodes || !p->node_hash) {
+    profile_free(p);
+    return false;
+  }
+  p->period = period ? period : 1;
+  p->node_count = 1; // root
+  return true;
+}
+
+void profile_free(profile_t *p) {
+  if (!p) return;
+  free(p->pc_samples);
+  free(p->nodes);
+  free(p->node_hash);
+  memset(p, 0, sizeof(*p));
+}
+
+static uint32_t node_hash(uint32_t parent, uint16_t addr, uint8_t kind) {
+  uint32_t h = parent * 0x9E3779B1u ^ ((uint32_t)addr << 3 | kind) * 0x85EBCA77u;
+  return (h ^ (h >> 15)) & (HASH_SLOTS - 1);
+}
+
+static uint32_t child_node(profile_t *p, uint32_t parent, uint16_t addr, uint8_t kind) {
+  uint32_t slot = node_hash(parent, addr, kind);
+  for (;;) {
+    uint32_t idx = p->node_hash[slot];
+    if (idx == 0) break;
+    const profile_node_t *nd = &p->nodes[idx];
+    if (nd->parent == parent && nd->addr == addr && nd->kind == kind) return idx;
+    slot = (slot + 1) & (HASH_SLOTS - 1);
+  }
+  if (p->node_count >= PROFILE_MAX_NODES) return UINT32_MAX;
+  uint32_t idx = p->node_count++;
+  profile_node_t *nd = &p->nodes[idx];
+  nd->parent = parent;
+  nd->addr = addr;
+  nd->kind = kind;
+  nd->depth = (uint8_t)(p->nodes[parent].depth + 1);
+  p->node_hash[slot] = idx;
+  return idx;
+}
+
+static uint32_t current_node(const profile_t *p) {
+  return p->depth ? p->stack[p->depth - 1].node : 0;
+}
+
+// Charges the cycles since the previous hook to the path and PC that ran them.
+static void account(profile_t *p, uint64_t cycles) {
+  p->nodes[p->last_node].cycles += cycles - p->last_cycles;
+  p->last_cycles = cycles;
+  while (p->next_sample <= cycles) {
+    p->next_sample += p->period;
+    p->pc_samples[p->last_pc]++;
+    p->samples++;
+  }
+}
+
+static void push_frame(profile_t *p, uint16_t addr, uint8_t kind, int sp) {
+  uint32_t idx = (p->depth < PROFILE_MAX_DEPTH) ? child_node(p, current_node(p), addr, kind) : UINT32_MAX;
+  if (idx == UINT32_MAX) {
+    p->dropped_frames++;
+    return;
+  }
+  p->stack[p->depth].node = idx;
+  p->stack[p->depth].sp = sp;
+  p->depth++;
+}
+
+// Games return through hand-built stacks, discard return addresses and reset
+// SP, so frames are popped by stack position rather than strictly per RTS.
+static void pop_frames(profile_t *p, int sp_after) {
+  while (p->depth > 0 && p->stack[p->depth - 1].sp <= sp_after) p->depth--;
+}
+
+void profile_instruction(profile_t *p, struct nes *nes) {
+  nes_t *n = (nes_t *)nes;
+  const cpu6502_t *c = &n->cpu;
+  account(p, c->cycles);
+
+  // Cycles of the instruction about to run go to the path active before it.
+  p->last_pc = c->pc;
+  p->last_node = current_node(p);
+  switch (nes_cpu_peek(n, c->pc)) {
+    case 0x20: {
+      uint16_t target = (uint16_t)(nes_cpu_peek(n, (uint16_t)(c->pc + 1)) |
+                                   (nes_cpu_peek(n, (uint16_t)(c->pc + 2)) << 8));
+      push_frame(p, target, PROFILE_FRAME_JSR, c->sp);
+      break;
+    }
+    case 0x00: {
+      uint16_t target = (uint16_t)(nes_cpu_peek(n, 0xFFFE) | (nes_cpu_peek(n, 0xFFFF) << 8));
+      push_frame(p, target, PROFILE_FRAME_BRK, c->sp);
+      break;
+    }
+    case 0x60: pop_frames(p, c->sp + 2); break; // RTS
+    case 0x40: pop_frames(p, c->sp + 3); break; // RTI
+    case 0x9A: pop_frames(p, c->x); break;      // TXS
+    default: break;
+  }
+}
+
+void profile_interrupt(profile_t *p, struct nes *nes, uint16_t vector) {
+  nes_t *n = (nes_t *)nes;
+  account(p, n->cpu.cycles);
+  uint16_t target = (uint16_t)(nes_cpu_peek(n, vector) | (nes_cpu_peek(n, (uint16_t)(vector + 1)) << 8));
+  push_frame(p, target, vector == 0xFFFA ? PROFILE_FRAME_NMI : PROFILE_FRAME_IRQ, n->cpu.sp);
+  p->last_node = current_node(p);
+}
+
+static int frame_name(char *out, size_t cap, const profile_node_t *nd) {
+  switch (nd->kind) {
+    case PROFILE_FRAME_JSR: return snprintf(out, cap, "sub_%04X", nd->addr);
+    case PROFILE_FRAME_NMI: return snprintf(out, cap, "nmi_%04X", nd->addr);
+    case PROFILE_FRAME_IRQ: return snprintf(out, cap, "irq_%04X", nd->addr);
+    case PROFILE_FRAME_BRK: return snprintf(out, cap, "brk_%04X", nd->addr);
+    default: return snprintf(out, cap, "main");
+  }
+}
+
+bool profile_save_folded(const profile_t *p, const char *path, char *err, size_t err_cap) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    if (err && err_cap) snprintf(err, err_cap, "failed to open %s", path);
+    return false;
+  }
+  bool ok = true;
+  for (uint32_t i = 0; i < p->node_count && ok; i++) {
+    if (p->nodes[i].cycles == 0) continue;
+    // Walk to the root, then print the path outermost frame first.
+    uint32_t path_nodes[PROFILE_MAX_DEPTH + 1];
+    int len = 0;
+    for (uint32_t k = i; len <= PROFILE_MAX_DEPTH; k = p->nodes[k].parent) {
+      path_nodes[len++] = k;
+      if (k == 0) break;
+    }
+    char line[PROFILE_MAX_DEPTH * 10 + 32];
+    size_t pos = 0;
+    for (int d = len - 1; d >= 0; d--) {
+      pos += (size_t)frame_name(line + pos, sizeof(line) - pos, &p->nodes[path_nodes[d]]);
+      if (d > 0) line[pos++] = ';';
+    }
+    line[pos] = '\0';
+    ok = fprintf(f, "%s %llu\n", line, (unsigned long long)p->nodes[i].cycles) > 0;
+  }
+  if (fclose(f) != 0) ok = false;
+  if (!ok && err && err_cap) snprintf(err, err_cap, "failed writing %s", path);
+  return ok;
+}
+
+void profile_report(const profile_t *p, FILE *out, int top) {
+  fprintf(out, "profile: %llu samples (1 per %u CPU cycles), %u call paths",
+          (unsigned long long)p->samples, p->period, p->node_count);
+  if (p->dropped_frames) fprintf(out, ", %llu frames dropped", (unsigned long long)p->dropped_frames);
+  fprintf(out, "\n");
+  if (p->samples == 0) return;
+
+  // Selection of the hottest entries; top is small so a linear scan per rank is fine.
+  uint32_t prev_count = UINT32_MAX;
+  int prev_pc = -1;
+  for (int rank = 0; rank < top; rank++) {
+    int best = -1;
+    for (int pc = 0; pc < 0x10000; pc++) {
+      uint32_t v = p->pc_samples[pc];
+      if (v == 0 || v > prev_count || (v == prev_count && pc <= prev_pc)) continue;
+      if (best < 0 || v > p->pc_samples[best]) best = pc;
+    }
+    if (best < 0) break;
+    uint32_t v = p->pc_samples[best];
+    fprintf(out, "  $%04X %10u %5.1f%%\n", best, v, 100.0 * (double)v / (double)p->samples);
+    prev_count = v;
+    prev_pc = best;
+  }
+}
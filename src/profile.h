@@ -0,0 +1,57 @@
+#pragma once
+#include "common.h"
+#include <stdio.h>
+
+struct nes;
+
+// Guest profiler: samples the 6502 PC into a 64K histogram every `period` CPU
+// cycles and charges every cycle to the current guest call stack, tracked with
+// a shadow stack of JSR/interrupt frames.
+enum { PROFILE_MAX_DEPTH = 64, PROFILE_MAX_NODES = 1 << 16 };
+
+typedef enum { PROFILE_FRAME_ROOT, PROFILE_FRAME_JSR, PROFILE_FRAME_NMI, PROFILE_FRAME_IRQ, PROFILE_FRAME_BRK } profile_frame_kind_t;
+
+// One node per distinct call path; node 0 is the root (code outside any call).
+typedef struct {
+  uint32_t parent;
+  uint16_t addr; // JSR target or interrupt vector destination
+  uint8_t kind;
+  uint8_t depth;
+  uint64_t cycles; // self cycles spent with this path on top of the stack
+} profile_node_t;
+
+typedef struct {
+  uint32_t node;
+  int sp; // guest SP before the call pushed its return address
+} profile_frame_t;
+
+typedef struct profile {
+  uint32_t *pc_samples; // 64K entries
+  uint64_t samples;
+  uint32_t period;
+  uint64_t next_sample;
+
+  profile_node_t *nodes;
+  uint32_t node_count;
+  uint32_t *node_hash; // open addressing, 2 * PROFILE_MAX_NODES slots, 0 = empty
+  uint64_t dropped_frames;
+
+  profile_frame_t stack[PROFILE_MAX_DEPTH];
+  int depth;
+  uint32_t last_node;
+  uint16_t last_pc;
+  uint64_t last_cycles;
+} profile_t;
+
+bool profile_init(profile_t *p, uint32_t period);
+void profile_free(profile_t *p);
+
+// Hot path: called by the CPU core before each instruction / interrupt entry.
+void profile_instruction(profile_t *p, struct nes *nes);
+void profile_interrupt(profile_t *p, struct nes *nes, uint16_t vector);
+
+// Folded stacks ("main;sub_C123;nmi_C0A5 <cycles>"), one line per call path,
+// as consumed by flamegraph.pl and speedscope.
+bool profile_save_folded(const profile_t *p, const char *path, char *err, size_t err_cap);
+// Prints the `top` most sampled guest PCs.
+void profile_report(const profile_t *p, FILE *out, int top);
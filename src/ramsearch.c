@@ -0,0 +1,96 @@
+#include "ramsearch.h"
+#include "nes.h"
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static void snapshot(uint8_t *dst, const nes_t *n) {
+  memcpy(dst, n->ram, 2048);
+  memcpy(dst + 2048, n->cart.prg_ram, 8192);
+}
+
+static uint16_t cpu_addr(size_t i) { return (uint16_t)(i < 2048 ? i : 0x6000 + (i - 2048)); }
+
+void ramsearch_reset(ramsearch_t *rs, const struct nes *n) {
+  snapshot(rs->prev, (const nes_t *)n);
+  memset(rs->cand, 0xFF, sizeof(rs->cand));
+  rs->count = RAMSEARCH_SIZE;
+}
+
+#if defined(__SSE2__)
+// 16 compares at once; returns one bit per byte.
+static uint16_t compare16(const uint8_t *cur, const uint8_t *prev, ramsearch_op_t op, bool against_value, uint8_t value) {
+  __m128i a = _mm_loadu_si128((const __m128i *)cur);
+  __m128i p = _mm_loadu_si128((const __m128i *)prev);
+  __m128i v = _mm_set1_epi8((char)value);
+  __m128i b = against_value ? v : p;
+  __m128i m;
+  // SSE2 only has signed byte compares; flipping the top bit orders unsigned values.
+  const __m128i bias = _mm_set1_epi8((char)0x80);
+  switch (op) {
+    case RAMSEARCH_EQ: m = _mm_cmpeq_epi8(a, b); break;
+    case RAMSEARCH_NE: m = _mm_xor_si128(_mm_cmpeq_epi8(a, b), _mm_set1_epi8(-1)); break;
+    case RAMSEARCH_GT: m = _mm_cmpgt_epi8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)); break;
+    case RAMSEARCH_LT: m = _mm_cmplt_epi8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)); break;
+    case RAMSEARCH_GE: m = _mm_cmpeq_epi8(_mm_max_epu8(a, b), a); break;
+    case RAMSEARCH_LE: m = _mm_cmpeq_epi8(_mm_min_epu8(a, b), a); break;
+    case RAMSEARCH_CHANGED_BY: m = _mm_cmpeq_epi8(_mm_sub_epi8(a, p), v); break;
+    default: m = _mm_setzero_si128(); break;
+  }
+  return (uint16_t)_mm_movemask_epi8(m);
+}
+#else
+static uint16_t compare16(const uint8_t *cur, const uint8_t *prev, ramsearch_op_t op, bool against_value, uint8_t value) {
+  uint16_t bits = 0;
+  for (int i = 0; i < 16; i++) {
+    uint8_t a = cur[i], b = against_value ? value : prev[i];
+    bool keep = false;
+    switch (op) {
+      case RAMSEARCH_EQ: keep = a == b; break;
+      case RAMSEARCH_NE: keep = a != b; break;
+      case RAMSEARCH_GT: keep = a > b; break;
+      case RAMSEARCH_LT: keep = a < b; break;
+      case RAMSEARCH_GE: keep = a >= b; break;
+      case RAMSEARCH_LE: keep = a <= b; break;
+      case RAMSEARCH_CHANGED_BY: keep = (uint8_t)(a - prev[i]) == value; break;
+    }
+    bits |= (uint16_t)(keep ? 1u << i : 0u);
+  }
+  return bits;
+}
+#endif
+
+static int popcount16(uint16_t v) {
+  int c = 0;
+  for (; v; v &= (uint16_t)(v - 1)) c++;
+  return c;
+}
+
+uint32_t ramsearch_filter(ramsearch_t *rs, const struct nes *n, ramsearch_op_t op, bool against_value, uint8_t value) {
+  uint8_t cur[RAMSEARCH_SIZE];
+  snapshot(cur, (const nes_t *)n);
+  uint32_t count = 0;
+  for (size_t k = 0; k < RAMSEARCH_SIZE / 16; k++) {
+    uint16_t c = rs->cand[k];
+    if (!c) continue;
+    c &= compare16(cur + k * 16, rs->prev + k * 16, op, against_value, value);
+    rs->cand[k] = c;
+    count += (uint32_t)popcount16(c);
+  }
+  memcpy(rs->prev, cur, sizeof(cur));
+  rs->count = count;
+  return count;
+}
+
+size_t ramsearch_results(const ramsearch_t *rs, uint16_t *addrs, size_t cap) {
+  size_t out = 0;
+  for (size_t k = 0; k < RAMSEARCH_SIZE / 16 && out < cap; k++) {
+    for (uint16_t c = rs->cand[k]; c && out < cap; c &= (uint16_t)(c - 1)) {
+      int bit = 0;
+      while (!((c >> bit) & 1)) bit++;
+      addrs[out++] = cpu_addr(k * 16 + (size_t)bit);
+    }
+  }
+  return out;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "common.h"
+
+struct nes;
+
+// RAM search over CPU RAM ($0000-$07FF) followed by PRG RAM ($6000-$7FFF).
+// Candidates are a bitmap with one bit per byte; each filter compares the
+// current memory against the previous snapshot (or a constant) 16 bytes at a
+// time and ANDs the result in, skipping chunks with no candidates left.
+enum { RAMSEARCH_SIZE = 2048 + 8192 };
+
+typedef enum {
+  RAMSEARCH_EQ,         // cur == rhs
+  RAMSEARCH_NE,         // cur != rhs
+  RAMSEARCH_GT,         // cur >  rhs (unsigned)
+  RAMSEARCH_LT,         // cur <  rhs
+  RAMSEARCH_GE,         // cur >= rhs
+  RAMSEARCH_LE,         // cur <= rhs
+  RAMSEARCH_CHANGED_BY, // cur - prev == value (mod 256); rhs is always the previous snapshot
+} ramsearch_op_t;
+
+typedef struct ramsearch {
+  uint8_t prev[RAMSEARCH_SIZE];
+  uint16_t cand[RAMSEARCH_SIZE / 16]; // bit i of cand[k] = byte k * 16 + i is still a candidate
+  uint32_t count;
+} ramsearch_t;
+
+// Every byte becomes a candidate; takes the first snapshot.
+void ramsearch_reset(ramsearch_t *rs, const struct nes *n);
+// Keeps the candidates for which `cur op rhs` holds, where rhs is the previous
+// snapshot or, with against_value, the constant `value`. Then re-snapshots.
+// Returns the number of candidates left.
+uint32_t ramsearch_filter(ramsearch_t *rs, const struct nes *n, ramsearch_op_t op, bool against_value, uint8_t value);
+// Writes the CPU addresses of up to `cap` candidates; returns how many were written.
+size_t ramsearch_results(const ramsearch_t *rs, uint16_t *addrs, size_t cap);
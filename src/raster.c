@@ -0,0 +1,287 @@
+#define _POSIX_C_SOURCE 200809L
+#include "raster.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Command stream: one opcode byte, then a fixed payload (native layout; the
+// buffer never leaves the process).
+enum { CMD_WRITE = 1, CMD_LINE = 2, CMD_SYNC = 3 };
+
+typedef struct {
+  uint16_t addr;
+  uint8_t v;
+} cmd_write_t;
+
+typedef struct {
+  uint8_t y;
+  ppu_view_t view; // after the line's writes; the log undoes them
+  uint8_t spr_count;
+  uint8_t spr_i[8], spr_y[8], spr_tile[8], spr_attr[8], spr_x[8];
+  uint8_t log_count;
+  bool log_overflow;
+} cmd_line_t; // followed by log_count ppu_line_write_t
+
+typedef struct {
+  uint8_t palette[32];
+  uint8_t vram[2048];
+  uint32_t chr_size; // followed by chr_size bytes of CHR RAM (0 = unchanged)
+} cmd_sync_t;
+
+// NULL when the buffer cannot grow. The command is dropped and the batch is
+// flagged, so raster_end_frame() closes it with a full memory sync instead
+// of letting the worker's copy drift from the machine for good.
+static uint8_t *reserve(ppu_raster_t *r, size_t n) {
+  if (r->rec_len + n > r->rec_cap) {
+    size_t cap = r->rec_cap ? r->rec_cap : 16384;
+    while (cap < r->rec_len + n) cap *= 2;
+    uint8_t *p = (uint8_t *)realloc(r->rec, cap);
+    if (!p) {
+      r->lost = true;
+      return NULL;
+    }
+    r->rec = p;
+    r->rec_cap = cap;
+  }
+  uint8_t *p = r->rec + r->rec_len;
+  r->rec_len += n;
+  return p;
+}
+
+void raster_record_write(ppu_raster_t *r, uint16_t addr, uint8_t v) {
+  uint8_t *p = reserve(r, 1 + sizeof(cmd_write_t));
+  if (!p) return;
+  cmd_write_t c = { addr, v };
+  p[0] = CMD_WRITE;
+  memcpy(p + 1, &c, sizeof(c));
+}
+
+void raster_record_line(ppu_raster_t *r, const ppu_t *p, int y) {
+  int n = p->line_log_overflow ? 0 : p->line_log_count;
+  uint8_t *o = reserve(r, 1 + sizeof(cmd_line_t) + (size_t)n * sizeof(ppu_line_write_t));
+  if (!o) return;
+  cmd_line_t c;
+  memset(&c, 0, sizeof(c));
+  c.y = (uint8_t)y;
+  c.view.mask = p->reg_mask;
+  c.view.ctrl = p->render_ctrl;
+  c.view.scroll_x = p->scroll_x;
+  c.view.scroll_y = p->scroll_y;
+  c.spr_count = p->scan_spr_count;
+  memcpy(c.spr_i, p->scan_spr_i, 8);
+  memcpy(c.spr_y, p->scan_spr_y, 8);
+  memcpy(c.spr_tile, p->scan_spr_tile, 8);
+  memcpy(c.spr_attr, p->scan_spr_attr, 8);
+  memcpy(c.spr_x, p->scan_spr_x, 8);
+  c.log_count = (uint8_t)n;
+  c.log_overflow = p->line_log_overflow;
+  o[0] = CMD_LINE;
+  memcpy(o + 1, &c, sizeof(c));
+  memcpy(o + 1 + sizeof(c), p->line_log, (size_t)n * sizeof(ppu_line_write_t));
+  r->rec_lines++;
+}
+
+void raster_record_sync(ppu_raster_t *r, const ppu_t *p, const uint8_t *chr_ram, size_t chr_size) {
+  if (!chr_ram) chr_size = 0;
+  uint8_t *o = reserve(r, 1 + sizeof(cmd_sync_t) + chr_size);
+  if (!o) return;
+  cmd_sync_t c;
+  memcpy(c.palette, p->palette, sizeof(c.palette));
+  memcpy(c.vram, p->vram, sizeof(c.vram));
+  c.chr_size = (uint32_t)chr_size;
+  o[0] = CMD_SYNC;
+  memcpy(o + 1, &c, sizeof(c));
+  if (chr_size) memcpy(o + 1 + sizeof(c), chr_ram, chr_size);
+}
+
+// Worker side: replays one frame's commands against the shadow machine.
+static void replay(ppu_raster_t *r) {
+  nes_t *s = &r->shadow;
+  const uint8_t *p = r->work, *end = r->work + r->work_len;
+  while (p < end) {
+    uint8_t op = *p++;
+    if (op == CMD_WRITE) {
+      cmd_write_t c;
+      memcpy(&c, p, sizeof(c));
+      p += sizeof(c);
+      nes_ppu_bus_write((struct nes *)s, c.addr, c.v);
+    } else if (op == CMD_LINE) {
+      cmd_line_t c;
+      memcpy(&c, p, sizeof(c));
+      p += sizeof(c);
+      ppu_t *pp = &s->ppu;
+      pp->reg_mask = c.view.mask;
+      pp->render_ctrl = c.view.ctrl;
+      pp->scroll_x = c.view.scroll_x;
+      pp->scroll_y = c.view.scroll_y;
+      pp->scan_spr_count = c.spr_count;
+      memcpy(pp->scan_spr_i, c.spr_i, 8);
+      memcpy(pp->scan_spr_y, c.spr_y, 8);
+      memcpy(pp->scan_spr_tile, c.spr_tile, 8);
+      memcpy(pp->scan_spr_attr, c.spr_attr, 8);
+      memcpy(pp->scan_spr_x, c.spr_x, 8);
+      memcpy(pp->line_log, p, (size_t)c.log_count * sizeof(ppu_line_write_t));
+      p += (size_t)c.log_count * sizeof(ppu_line_write_t);
+      pp->line_log_count = c.log_count;
+      pp->line_log_overflow = c.log_overflow;
+      ppu_render_line(pp, (struct nes *)s, c.y);
+    } else if (op == CMD_SYNC) {
+      cmd_sync_t c;
+      memcpy(&c, p, sizeof(c));
+      p += sizeof(c);
+      memcpy(s->ppu.palette, c.palette, sizeof(c.palette));
+      memcpy(s->ppu.vram, c.vram, sizeof(c.vram));
+      if (c.chr_size && r->shadow_chr) memcpy(r->shadow_chr, p, c.chr_size);
+      p += c.chr_size;
+    } else {
+      break;
+    }
+  }
+}
+
+static void *worker_main(void *arg) {
+  ppu_raster_t *r = (ppu_raster_t *)arg;
+  pthread_mutex_lock(&r->lock);
+  for (;;) {
+    while (!r->busy && !r->stop) pthread_cond_wait(&r->work_cond, &r->lock);
+    if (!r->busy) break;
+    pthread_mutex_unlock(&r->lock);
+    replay(r);
+    pthread_mutex_lock(&r->lock);
+    r->busy = false;
+    pthread_cond_signal(&r->done_cond);
+  }
+  pthread_mutex_unlock(&r->lock);
+  return NULL;
+}
+
+static void set_shadow_target(ppu_raster_t *r, int plane) {
+  ppu_set_frame_block(&r->shadow.ppu, r->planes[plane]);
+}
+
+void raster_end_frame(ppu_raster_t *r, ppu_t *p) {
+  if (r->lost) {
+    // Still failing keeps `lost` set and tries again next frame.
+    r->lost = false;
+    raster_record_sync(r, p, r->chr_ram, r->chr_size);
+  }
+  pthread_mutex_lock(&r->lock);
+  while (r->busy) pthread_cond_wait(&r->done_cond, &r->lock);
+  // The frame the worker just finished becomes visible. A batch without
+  // lines (e.g. netplay re-simulation) only updated memory; keep the old one.
+  if (r->work_lines > 0) {
+    r->front ^= 1;
+    ppu_set_frame_block(p, r->planes[r->front]);
+  }
+  uint8_t *buf = r->work;
+  size_t cap = r->work_cap;
+  r->work = r->rec;
+  r->work_cap = r->rec_cap;
+  r->work_len = r->rec_len;
+  r->work_lines = r->rec_lines;
+  r->rec = buf;
+  r->rec_cap = cap;
+  r->rec_len = 0;
+  r->rec_lines = 0;
+  set_shadow_target(r, r->front ^ 1);
+  r->busy = true;
+  pthread_cond_signal(&r->work_cond);
+  pthread_mutex_unlock(&r->lock);
+}
+
+bool raster_start(ppu_raster_t *r, nes_t *n, char *err, size_t err_cap) {
+  memset(r, 0, sizeof(*r));
+  r->planes[0] = n->ppu.framebuffer;
+  r->planes[1] = (uint32_t *)malloc(PPU_FRAME_BYTES);
+  if (n->cart.chr_is_ram) r->shadow_chr = (uint8_t *)malloc(n->cart.info.chr_rom_size);
+  if (!r->planes[1] || (n->cart.chr_is_ram && !r->shadow_chr)) {
+    free(r->planes[1]);
+    free(r->shadow_chr);
+    if (err && err_cap) snprintf(err, err_cap, "out of memory");
+    return false;
+  }
+  memcpy(r->planes[1], r->planes[0], PPU_FRAME_BYTES);
+
+  // The shadow only needs what the scanline renderer reads: the cart's CHR
+  // and mirroring, palette, VRAM and the per-line registers. The output
+  // palette is the machine's own, read in place.
+  nes_t *s = &r->shadow;
+  s->cart.info = n->cart.info;
+  s->cart.chr_is_ram = n->cart.chr_is_ram;
+  s->cart.chr = n->cart.chr_is_ram ? r->shadow_chr : n->cart.chr;
+  r->chr_ram = n->cart.chr_is_ram ? n->cart.chr : NULL;
+  r->chr_size = n->cart.info.chr_rom_size;
+  if (r->shadow_chr) memcpy(r->shadow_chr, n->cart.chr, n->cart.info.chr_rom_size);
+  memcpy(s->ppu.palette, n->ppu.palette, sizeof(s->ppu.palette));
+  memcpy(s->ppu.vram, n->ppu.vram, sizeof(s->ppu.vram));
+  s->ppu.rgb = n->ppu.rgb;
+  s->ppu.render_mode = PPU_RENDER_FAST;
+  set_shadow_target(r, 1);
+
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->work_cond, NULL);
+  pthread_cond_init(&r->done_cond, NULL);
+  if (pthread_create(&r->thread, NULL, worker_main, r) != 0) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->work_cond);
+    pthread_cond_destroy(&r->done_cond);
+    free(r->planes[1]);
+    free(r->shadow_chr);
+    if (err && err_cap) snprintf(err, err_cap, "cannot start raster thread");
+    return false;
+  }
+  return true;
+}
+
+void raster_stop(ppu_raster_t *r, nes_t *n) {
+  pthread_mutex_lock(&r->lock);
+  while (r->busy) pthread_cond_wait(&r->done_cond, &r->lock);
+  r->stop = true;
+  pthread_cond_signal(&r->work_cond);
+  pthread_mutex_unlock(&r->lock);
+  pthread_join(r->thread, NULL);
+  pthread_mutex_destroy(&r->lock);
+  pthread_cond_destroy(&r->work_cond);
+  pthread_cond_destroy(&r->done_cond);
+
+  // Keep showing the newest finished frame from the machine's own block.
+  int newest = r->work_lines > 0 ? r->front ^ 1 : r->front;
+  if (newest != 0) memcpy(r->planes[0], r->planes[newest], PPU_FRAME_BYTES);
+  ppu_set_frame_block(&n->ppu, r->planes[0]);
+  free(r->planes[1]);
+  free(r->shadow_chr);
+  free(r->rec);
+  free(r->work);
+  memset(r, 0, sizeof(*r));
+}
+
+bool nes_set_raster_thread(nes_t *n, bool on, char *err, size_t err_cap) {
+  if (!on) {
+    if (n->ppu.raster) {
+      raster_stop(n->ppu.raster, n);
+      free(n->ppu.raster);
+      n->ppu.raster = NULL;
+    }
+    return true;
+  }
+  if (n->ppu.raster) return true;
+  if (n->ppu.framebuffer != n->frame_block) {
+    if (err && err_cap) snprintf(err, err_cap, "the raster thread cannot draw into an external frame output");
+    return false;
+  }
+  if (n->ppu.render_mode != PPU_RENDER_FAST) {
+    if (err && err_cap) snprintf(err, err_cap, "the raster thread needs the fast PPU mode");
+    return false;
+  }
+  ppu_raster_t *r = (ppu_raster_t *)malloc(sizeof(*r));
+  if (!r) {
+    if (err && err_cap) snprintf(err, err_cap, "out of memory");
+    return false;
+  }
+  if (!raster_start(r, n, err, err_cap)) {
+    free(r);
+    return false;
+  }
+  n->ppu.raster = r;
+  return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "common.h"
+#include "nes.h"
+#include <pthread.h>
+
+// Pipelined fast-mode rasterizer. The emulation thread no longer draws
+// scanlines: it appends each line's render inputs (view registers, sprite
+// list, mid-line write log) and every VRAM/palette/CHR RAM write to a command
+// buffer. At vblank the buffer is handed to a worker thread, which replays
+// it against its own copy of PPU memory and draws the frame while the next
+// one is emulated. ppu.framebuffer therefore shows the previous frame.
+// Sprite-0 hit is still decided on the emulation thread.
+typedef struct ppu_raster {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond, done_cond;
+  bool busy; // worker owns `work` and the back planes
+  bool stop;
+
+  // Commands being recorded (emulation thread) and being drawn (worker).
+  uint8_t *rec, *work;
+  size_t rec_len, rec_cap, work_len, work_cap;
+  int rec_lines, work_lines;
+  bool lost; // a command could not be recorded; the batch ends with a full sync
+
+  const uint8_t *chr_ram; // the machine's CHR RAM for such syncs (NULL when CHR is ROM)
+  size_t chr_size;
+
+  uint32_t *planes[2]; // frame output blocks (PPU_FRAME_BYTES); planes[0] is the machine's own
+  int front;           // plane ppu.framebuffer points at
+
+  nes_t shadow; // the worker's PPU memory, view registers and output target
+  uint8_t *shadow_chr; // CHR RAM copy (NULL when CHR is ROM, which is shared)
+} ppu_raster_t;
+
+// Starts the worker for `n` (fast mode only; accurate mode keeps drawing on
+// the emulation thread). Use nes_set_raster_thread() rather than these.
+bool raster_start(ppu_raster_t *r, nes_t *n, char *err, size_t err_cap);
+// Waits for the worker, puts the newest finished frame back into the
+// machine's own framebuffer and stops the thread.
+void raster_stop(ppu_raster_t *r, nes_t *n);
+
+// Hooks called from the PPU.
+void raster_record_line(ppu_raster_t *r, const ppu_t *p, int y);
+void raster_record_write(ppu_raster_t *r, uint16_t addr, uint8_t v);
+// Full copy of palette and VRAM (and CHR RAM when `chr_ram` is not NULL),
+// after a reset or state load changed them behind the PPU's back.
+void raster_record_sync(ppu_raster_t *r, const ppu_t *p, const uint8_t *chr_ram, size_t chr_size);
+void raster_end_frame(ppu_raster_t *r, ppu_t *p);
@@ -0,0 +1,28 @@
+#include "romdb.h"
+#include "romdb_table.h"
+
+const romdb_entry_t *romdb_lookup(uint32_t crc32) {
+  uint32_t mask = ROMDB_TABLE_SIZE - 1;
+  for (uint32_t i = crc32 & mask;; i = (i + 1) & mask) {
+    const romdb_entry_t *e = &romdb_table[i];
+    if (!(e->flags & ROMDB_F_USED)) return NULL;
+    if (e->crc32 == crc32) return e;
+  }
+}
+
+static uint32_t ram_size(uint8_t shift) { return shift ? (64u << shift) : 0; }
+
+void romdb_apply(const romdb_entry_t *e, ines_info_t *info) {
+  info->mapper = e->mapper;
+  info->submapper = e->submapper;
+  info->mirror = (nes_mirror_t)e->mirror;
+  info->timing = (nes_timing_t)e->timing;
+  info->has_battery = (e->flags & ROMDB_F_BATTERY) != 0;
+  info->prg_rom_size = (uint32_t)e->prg_rom_16k * 16u * 1024u;
+  info->chr_rom_size = (uint32_t)e->chr_rom_8k * 8u * 1024u;
+  info->prg_ram_size = ram_size(e->prg_ram_shift);
+  info->prg_nvram_size = ram_size(e->prg_nvram_shift);
+  info->chr_ram_size = ram_size(e->chr_ram_shift);
+  info->chr_nvram_size = ram_size(e->chr_nvram_shift);
+  info->db_match = true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "common.h"
+#include "ines.h"
+
+// Header overrides for known-good dumps, keyed by the CRC-32 of the ROM data
+// that follows the 16-byte header (PRG then CHR, i.e. the headerless dump).
+// The table itself is generated from tools/romdb.txt by tools/mk_romdb. The
+// checked-in table is only a seed (one entry); a real database is imported
+// with `make romdb ROMDB_XML=nes20db.xml`.
+typedef struct {
+  uint32_t crc32;
+  uint16_t mapper;
+  uint8_t submapper;
+  uint8_t flags;          // ROMDB_F_*
+  uint16_t prg_rom_16k;   // PRG ROM size in 16KB units
+  uint16_t chr_rom_8k;    // CHR ROM size in 8KB units (0 = CHR RAM)
+  uint8_t prg_ram_shift;  // RAM sizes use the NES 2.0 encoding: 64 << n bytes, 0 = none
+  uint8_t prg_nvram_shift;
+  uint8_t chr_ram_shift;
+  uint8_t chr_nvram_shift;
+  uint8_t mirror;         // nes_mirror_t
+  uint8_t timing;         // nes_timing_t
+} romdb_entry_t;
+
+enum { ROMDB_F_USED = 1, ROMDB_F_BATTERY = 2 };
+
+// O(1): one open-addressed probe sequence in a half-empty static table.
+const romdb_entry_t *romdb_lookup(uint32_t crc32);
+void romdb_apply(const romdb_entry_t *e, ines_info_t *info);
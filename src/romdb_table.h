@@ -0,0 +1,9 @@
+// Generated by tools/mk_romdb from tools/romdb.txt; do not edit.
+#pragma once
+#include "romdb.h"
+
+enum { ROMDB_TABLE_SIZE = 16 };
+
+static const romdb_entry_t romdb_table[ROMDB_TABLE_SIZE] = {
+  [6] = { 0x3337EC46u, 0, 0, 1, 2, 1, 0, 0, 0, 0, 1, 0 }, // Super Mario Bros. (World)
+};
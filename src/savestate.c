@@ -0,0 +1,219 @@
+#include "nes.h"
+#include "raster.h"
+#include <stdio.h>
+#include <string.h>
+
+#define STATE_MAGIC "NESSAV1"
+#define STATE_VERSION 3u
+
+// One routine walks every field for both directions, so the save and load
+// layouts cannot drift apart. With buf == NULL it only counts bytes.
+typedef struct {
+  uint8_t *buf;
+  size_t pos, cap;
+  bool loading;
+} state_io_t;
+
+static void io_bytes(state_io_t *io, void *v, size_t n) {
+  if (io->buf && io->pos + n <= io->cap) {
+    if (io->loading) memcpy(v, io->buf + io->pos, n);
+    else memcpy(io->buf + io->pos, v, n);
+  }
+  io->pos += n;
+}
+
+static void io_u8(state_io_t *io, uint8_t *v) { io_bytes(io, v, 1); }
+
+static void io_bool(state_io_t *io, bool *v) {
+  uint8_t b = *v ? 1 : 0;
+  io_u8(io, &b);
+  if (io->loading) *v = b != 0;
+}
+
+static void io_u16(state_io_t *io, uint16_t *v) {
+  uint8_t b[2] = { (uint8_t)*v, (uint8_t)(*v >> 8) };
+  io_bytes(io, b, 2);
+  if (io->loading) *v = (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static void io_u32(state_io_t *io, uint32_t *v) {
+  uint8_t b[4];
+  for (int i = 0; i < 4; i++) b[i] = (uint8_t)(*v >> (8 * i));
+  io_bytes(io, b, 4);
+  if (io->loading) {
+    uint32_t r = 0;
+    for (int i = 0; i < 4; i++) r |= (uint32_t)b[i] << (8 * i);
+    *v = r;
+  }
+}
+
+static void io_i32(state_io_t *io, int *v) {
+  uint32_t u = (uint32_t)*v;
+  io_u32(io, &u);
+  if (io->loading) *v = (int)u;
+}
+
+static void io_u64(state_io_t *io, uint64_t *v) {
+  uint32_t lo = (uint32_t)*v, hi = (uint32_t)(*v >> 32);
+  io_u32(io, &lo);
+  io_u32(io, &hi);
+  if (io->loading) *v = ((uint64_t)hi << 32) | lo;
+}
+
+static void io_view(state_io_t *io, ppu_view_t *v) {
+  io_u8(io, &v->mask);
+  io_u8(io, &v->ctrl);
+  io_u8(io, &v->scroll_x);
+  io_u8(io, &v->scroll_y);
+}
+
+// The CRC is computed once at load, so saving a state never rehashes the
+// ROM (netplay snapshots every frame).
+static uint32_t rom_hash(const nes_t *n) { return n->cart.info.crc32; }
+
+static void state_fields(state_io_t *io, nes_t *n) {
+  cpu6502_t *c = &n->cpu;
+  io_u16(io, &c->pc);
+  io_u8(io, &c->a);
+  io_u8(io, &c->x);
+  io_u8(io, &c->y);
+  io_u8(io, &c->sp);
+  uint8_t p = cpu6502_get_p(c);
+  io_u8(io, &p);
+  if (io->loading) cpu6502_set_p(c, p);
+  io_u64(io, &c->cycles);
+  io_bool(io, &c->nmi_pending);
+  io_bool(io, &c->irq_pending);
+
+  io_bytes(io, n->ram, sizeof(n->ram));
+  io_bytes(io, n->cart.prg_ram, 8u * 1024u);
+  if (n->cart.chr_is_ram) io_bytes(io, n->cart.chr, n->cart.info.chr_rom_size);
+  io_i32(io, &n->cpu_stall);
+  io_u64(io, &n->ppu_synced_cycles);
+  io_bytes(io, n->pad_state, sizeof(n->pad_state));
+  io_bytes(io, n->pad_shift, sizeof(n->pad_shift));
+  io_bool(io, &n->pad_strobe);
+  io_u8(io, &n->last_bus);
+  io_u64(io, &n->dbg_nmi_count);
+
+  ppu_t *pp = &n->ppu;
+  io_u8(io, &pp->reg_ctrl);
+  io_u8(io, &pp->reg_mask);
+  io_u8(io, &pp->reg_status);
+  io_u8(io, &pp->oam_addr);
+  io_bytes(io, pp->oam, sizeof(pp->oam));
+  io_bytes(io, pp->vram, sizeof(pp->vram));
+  io_bytes(io, pp->palette, sizeof(pp->palette));
+  io_u8(io, &pp->chr_read_buffer);
+  io_u16(io, &pp->v);
+  io_u16(io, &pp->t);
+  io_u8(io, &pp->x);
+  io_bool(io, &pp->w);
+  io_u8(io, &pp->scroll_x);
+  io_u8(io, &pp->scroll_y);
+  io_u8(io, &pp->scroll_x_next);
+  io_u8(io, &pp->scroll_y_next);
+  io_u8(io, &pp->render_ctrl);
+  io_u8(io, &pp->render_ctrl_next);
+  io_i32(io, &pp->scanline);
+  io_i32(io, &pp->dot);
+  io_bool(io, &pp->frame_ready);
+  io_bool(io, &pp->odd_frame);
+  io_u16(io, &pp->bg_shift_lo);
+  io_u16(io, &pp->bg_shift_hi);
+  io_u16(io, &pp->at_shift_lo);
+  io_u16(io, &pp->at_shift_hi);
+  io_u8(io, &pp->bg_next_tile);
+  io_u8(io, &pp->bg_next_attr);
+  io_u8(io, &pp->bg_next_lo);
+  io_u8(io, &pp->bg_next_hi);
+  // The ARGB framebuffer is rebuilt from the index and emphasis planes on load.
+  io_bytes(io, pp->pixel_index, PPU_PIXELS);
+  io_bytes(io, pp->line_emphasis, 240);
+  io_u8(io, &pp->line_log_count);
+  io_bool(io, &pp->line_log_overflow);
+  for (int i = 0; i < PPU_LINE_LOG_SIZE; i++) {
+    ppu_line_write_t *lw = &pp->line_log[i];
+    io_u16(io, &lw->dot);
+    io_u16(io, &lw->addr);
+    io_bool(io, &lw->has_mem);
+    io_u8(io, &lw->mem_old);
+    io_u8(io, &lw->mem_new);
+    io_view(io, &lw->before);
+    io_view(io, &lw->after);
+  }
+  io_u8(io, &pp->scan_spr_count);
+  io_bytes(io, pp->scan_spr_i, sizeof(pp->scan_spr_i));
+  io_bytes(io, pp->scan_spr_y, sizeof(pp->scan_spr_y));
+  io_bytes(io, pp->scan_spr_tile, sizeof(pp->scan_spr_tile));
+  io_bytes(io, pp->scan_spr_attr, sizeof(pp->scan_spr_attr));
+  io_bytes(io, pp->scan_spr_x, sizeof(pp->scan_spr_x));
+}
+
+static void state_header(state_io_t *io, char magic[8], uint32_t *version, uint32_t *hash) {
+  io_bytes(io, magic, 8);
+  io_u32(io, version);
+  io_u32(io, hash);
+}
+
+size_t nes_state_size(const nes_t *n) {
+  state_io_t io = { 0 };
+  char magic[8] = STATE_MAGIC;
+  uint32_t version = STATE_VERSION, hash = 0;
+  state_header(&io, magic, &version, &hash);
+  state_fields(&io, (nes_t *)n);
+  return io.pos;
+}
+
+bool nes_save_state(const nes_t *n, uint8_t *buf, size_t cap, size_t *out_size) {
+  size_t need = nes_state_size(n);
+  if (out_size) *out_size = need;
+  if (cap < need) return false;
+  state_io_t io = { buf, 0, cap, false };
+  char magic[8] = STATE_MAGIC;
+  uint32_t version = STATE_VERSION, hash = rom_hash(n);
+  state_header(&io, magic, &version, &hash);
+  // Saving only reads through the pointers.
+  state_fields(&io, (nes_t *)n);
+  return true;
+}
+
+bool nes_load_state(nes_t *n, const uint8_t *buf, size_t size, char *err, size_t err_cap) {
+  // Everything is validated before any field is touched, so a rejected
+  // state leaves the machine as it was.
+  state_io_t io = { (uint8_t *)buf, 0, size, true };
+  char magic[8];
+  uint32_t version = 0, hash = 0;
+  state_header(&io, magic, &version, &hash);
+  if (io.pos > size || memcmp(magic, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0) {
+    if (err && err_cap) snprintf(err, err_cap, "not a save state");
+    return false;
+  }
+  if (version != STATE_VERSION) {
+    if (err && err_cap) snprintf(err, err_cap, "unsupported save state version %u", version);
+    return false;
+  }
+  if (size != nes_state_size(n)) {
+    if (err && err_cap) snprintf(err, err_cap, "save state size mismatch");
+    return false;
+  }
+  if (hash != rom_hash(n)) {
+    if (err && err_cap) snprintf(err, err_cap, "save state belongs to a different ROM");
+    return false;
+  }
+  state_fields(&io, n);
+  if (n->ppu.line_log_count > PPU_LINE_LOG_SIZE) n->ppu.line_log_count = PPU_LINE_LOG_SIZE;
+  if (n->ppu.scan_spr_count > 8) n->ppu.scan_spr_count = 8;
+
+  for (int y = 0; y < 240; y++) {
+    const uint32_t *rgb = n->ppu.rgb + ((n->ppu.line_emphasis[y] & 7) << 6);
+    for (int x = 0; x < 256; x++) n->ppu.framebuffer[y * 256 + x] = rgb[n->ppu.pixel_index[y * 256 + x] & 0x3F];
+  }
+  if (n->ppu.raster) {
+    raster_record_sync(n->ppu.raster, &n->ppu, n->cart.chr_is_ram ? n->cart.chr : NULL, n->cart.info.chr_rom_size);
+  }
+  cpu6502_icache_flush_ram(n->icache);
+  n->cart.prg_ram_dirty = ~0u;
+  n->cpu_block_break = true;
+  return true;
+}
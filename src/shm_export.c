@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+#include "shm_export.h"
+#include "nes.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool shm_export_create(shm_export_t *s, const char *name, const uint32_t *palette, char *err, size_t err_cap) {
+  memset(s, 0, sizeof(*s));
+  if (name[0] != '/' || strlen(name) >= sizeof(s->name)) {
+    if (err && err_cap) snprintf(err, err_cap, "shm name must start with '/' and be shorter than %zu chars", sizeof(s->name));
+    return false;
+  }
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    if (err && err_cap) snprintf(err, err_cap, "shm_open %s: %s", name, strerror(errno));
+    return false;
+  }
+  if (ftruncate(fd, (off_t)sizeof(shm_export_region_t)) != 0) {
+    if (err && err_cap) snprintf(err, err_cap, "ftruncate %s: %s", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  void *m = mmap(NULL, sizeof(shm_export_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    if (err && err_cap) snprintf(err, err_cap, "mmap %s: %s", name, strerror(errno));
+    shm_unlink(name);
+    return false;
+  }
+  s->region = (shm_export_region_t *)m;
+  snprintf(s->name, sizeof(s->name), "%s", name);
+
+  // Fresh region is zero-filled; the magic goes in last so readers that
+  // check it never see a half-initialized header.
+  s->region->version = SHM_EXPORT_VERSION;
+  s->region->size = (uint32_t)sizeof(shm_export_region_t);
+  s->region->width = 256;
+  s->region->height = 240;
+  memcpy(s->region->palette, palette, sizeof(s->region->palette));
+  atomic_store_explicit(&s->region->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(s->region->magic, SHM_EXPORT_MAGIC, sizeof(SHM_EXPORT_MAGIC));
+  return true;
+}
+
+void shm_export_publish(shm_export_t *s, const struct nes *n) {
+  shm_export_region_t *r = s->region;
+  uint32_t seq = atomic_load_explicit(&r->seq, memory_order_relaxed);
+  atomic_store_explicit(&r->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  r->data.frame++;
+  r->data.cpu_cycles = n->cpu.cycles;
+  memcpy(r->data.framebuffer, n->ppu.framebuffer, sizeof(r->data.framebuffer));
+  memcpy(r->data.pixel_index, n->ppu.pixel_index, sizeof(r->data.pixel_index));
+  memcpy(r->data.line_emphasis, n->ppu.line_emphasis, sizeof(r->data.line_emphasis));
+  memcpy(r->data.ram, n->ram, sizeof(r->data.ram));
+
+  atomic_store_explicit(&r->seq, seq + 2, memory_order_release);
+}
+
+void shm_export_destroy(shm_export_t *s) {
+  if (!s->region) return;
+  munmap(s->region, sizeof(shm_export_region_t));
+  shm_unlink(s->name);
+  s->region = NULL;
+}
+
+bool shm_export_attach(shm_export_t *s, const char *name, char *err, size_t err_cap) {
+  memset(s, 0, sizeof(*s));
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    if (err && err_cap) snprintf(err, err_cap, "shm_open %s: %s", name, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_export_region_t)) {
+    if (err && err_cap) snprintf(err, err_cap, "%s: region too small (emulator version mismatch?)", name);
+    close(fd);
+    return false;
+  }
+  void *m = mmap(NULL, sizeof(shm_export_region_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    if (err && err_cap) snprintf(err, err_cap, "mmap %s: %s", name, strerror(errno));
+    return false;
+  }
+  shm_export_region_t *r = (shm_export_region_t *)m;
+  if (memcmp(r->magic, SHM_EXPORT_MAGIC, sizeof(SHM_EXPORT_MAGIC)) != 0 || r->version != SHM_EXPORT_VERSION ||
+      r->size != sizeof(shm_export_region_t)) {
+    if (err && err_cap) snprintf(err, err_cap, "%s: not a nes shm export (or version mismatch)", name);
+    munmap(m, sizeof(shm_export_region_t));
+    return false;
+  }
+  s->region = r;
+  snprintf(s->name, sizeof(s->name), "%s", name);
+  return true;
+}
+
+void shm_export_detach(shm_export_t *s) {
+  if (!s->region) return;
+  munmap(s->region, sizeof(shm_export_region_t));
+  s->region = NULL;
+}
+
+bool shm_export_snapshot(const shm_export_t *s, shm_export_data_t *out, int max_tries) {
+  shm_export_region_t *r = s->region;
+  for (int i = 0; i < max_tries; i++) {
+    uint32_t before = atomic_load_explicit(&r->seq, memory_order_acquire);
+    if (before & 1) continue;
+    memcpy(out, &r->data, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t after = atomic_load_explicit(&r->seq, memory_order_relaxed);
+    if (before == after) return true;
+  }
+  return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "common.h"
+#include "palette.h"
+#include <stdatomic.h>
+
+struct nes;
+
+// Shared-memory layout published by `nes --shm <name>` (POSIX shm_open name,
+// e.g. "/nes0"). The writer bumps `seq` to an odd value, copies the frame,
+// then bumps it to the next even value; readers retry until they see the
+// same even `seq` before and after their copy (a seqlock), so the emulator
+// never waits on readers. The palette is written once at create, before the
+// magic, and never changes.
+#define SHM_EXPORT_MAGIC "NESSHM1"
+#define SHM_EXPORT_VERSION 2u
+
+typedef struct {
+  uint64_t frame;                   // frames published so far
+  uint64_t cpu_cycles;
+  uint32_t framebuffer[256 * 240];  // 0xAARRGGBB
+  uint8_t pixel_index[256 * 240];   // master palette indices (0-63)
+  uint8_t line_emphasis[240];       // per line: PPUMASK bits 5-7 (>> 5)
+  uint8_t ram[2048];
+} shm_export_data_t;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t size;    // sizeof(shm_export_region_t)
+  _Atomic uint32_t seq;
+  uint32_t width, height;
+  uint32_t pad;
+  // 0xAARRGGBB; a pixel is palette[line_emphasis[y] << 6 | pixel_index[i]].
+  uint32_t palette[PALETTE_SIZE];
+  shm_export_data_t data;
+} shm_export_region_t;
+
+typedef struct shm_export {
+  shm_export_region_t *region;
+  char name[64];
+} shm_export_t;
+
+// Writer side (emulator). `palette` has PALETTE_SIZE entries.
+bool shm_export_create(shm_export_t *s, const char *name, const uint32_t *palette, char *err, size_t err_cap);
+void shm_export_publish(shm_export_t *s, const struct nes *n);
+void shm_export_destroy(shm_export_t *s); // unmaps and unlinks; attached readers keep their mapping
+
+// Reader side (other processes): maps the region read-only.
+bool shm_export_attach(shm_export_t *s, const char *name, char *err, size_t err_cap);
+void shm_export_detach(shm_export_t *s);
+// Copies a consistent snapshot; false if the writer kept it busy for `max_tries` attempts.
+bool shm_export_snapshot(const shm_export_t *s, shm_export_data_t *out, int max_tries);
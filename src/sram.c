@@ -0,0 +1,174 @@
+#define _POSIX_C_SOURCE 200809L
+#include "sram.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { SRAM_SIZE = 8192, SRAM_PAGE = 256 };
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+bool sram_load(cart_t *cart, const char *path, char *err, size_t err_cap) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return true;
+  size_t got = fread(cart->prg_ram, 1, SRAM_SIZE, f);
+  bool ok = !ferror(f);
+  fclose(f);
+  if (!ok) {
+    if (err && err_cap) snprintf(err, err_cap, "failed reading %s", path);
+    return false;
+  }
+  if (got < SRAM_SIZE) memset(cart->prg_ram + got, 0, SRAM_SIZE - got);
+  cart->prg_ram_dirty = 0;
+  return true;
+}
+
+// The rename itself lives in the directory entry, so it is only durable once
+// the directory is synced too. Filesystems that cannot sync a directory
+// (EINVAL) have nothing to flush.
+static bool sync_parent_dir(const sram_saver_t *s) {
+  char dir[sizeof(s->path)];
+  snprintf(dir, sizeof(dir), "%s", s->path);
+  char *slash = strrchr(dir, '/');
+  if (!slash) snprintf(dir, sizeof(dir), ".");
+  else if (slash == dir) slash[1] = 0;
+  else *slash = 0;
+  int fd = open(dir, O_RDONLY | O_DIRECTORY);
+  if (fd < 0) return false;
+  bool ok = fsync(fd) == 0 || errno == EINVAL;
+  close(fd);
+  return ok;
+}
+
+static bool write_file(const sram_saver_t *s, const uint8_t *data) {
+  FILE *f = fopen(s->tmp_path, "wb");
+  if (!f) return false;
+  bool ok = fwrite(data, 1, SRAM_SIZE, f) == SRAM_SIZE;
+  ok = (fflush(f) == 0) && ok;
+  ok = (fsync(fileno(f)) == 0) && ok;
+  ok = (fclose(f) == 0) && ok;
+  // rename() is atomic, so a crash leaves either the old or the new save.
+  if (ok) ok = rename(s->tmp_path, s->path) == 0;
+  if (!ok) {
+    remove(s->tmp_path);
+    return false;
+  }
+  return sync_parent_dir(s);
+}
+
+static void *writer_main(void *arg) {
+  sram_saver_t *s = (sram_saver_t *)arg;
+  uint8_t buf[SRAM_SIZE], on_disk[SRAM_SIZE];
+  pthread_mutex_lock(&s->lock);
+  memcpy(on_disk, s->shadow, sizeof(on_disk));
+  for (;;) {
+    if (!s->pending) {
+      if (s->stop) break;
+      pthread_cond_wait(&s->cond, &s->lock);
+      continue;
+    }
+    uint64_t due = s->last_change + s->quiet_ms;
+    if (due > s->first_change + SRAM_MAX_DELAY_MS) due = s->first_change + SRAM_MAX_DELAY_MS;
+    uint64_t now = now_ms();
+    if (!s->stop && now < due) {
+      // Coalesce: wait out the quiet interval; new writes push it further.
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      uint64_t ns = (uint64_t)ts.tv_nsec + (due - now) * 1000000u;
+      ts.tv_sec += (time_t)(ns / 1000000000u);
+      ts.tv_nsec = (long)(ns % 1000000000u);
+      pthread_cond_timedwait(&s->cond, &s->lock, &ts);
+      continue;
+    }
+    memcpy(buf, s->shadow, sizeof(buf));
+    s->pending = false;
+    // A game that wrote a byte and then put it back leaves nothing to save.
+    if (memcmp(buf, on_disk, sizeof(buf)) == 0) continue;
+    pthread_mutex_unlock(&s->lock);
+    bool ok = write_file(s, buf);
+    pthread_mutex_lock(&s->lock);
+    if (ok) {
+      memcpy(on_disk, buf, sizeof(on_disk));
+      s->saves++;
+    } else {
+      s->write_failed = true;
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+bool sram_open(sram_saver_t *s, const cart_t *cart, const char *path, uint32_t quiet_ms, char *err, size_t err_cap) {
+  memset(s, 0, sizeof(*s));
+  if (strlen(path) >= sizeof(s->path)) {
+    if (err && err_cap) snprintf(err, err_cap, "save path too long");
+    return false;
+  }
+  snprintf(s->path, sizeof(s->path), "%s", path);
+  snprintf(s->tmp_path, sizeof(s->tmp_path), "%s.tmp", path);
+  s->quiet_ms = quiet_ms;
+  memcpy(s->shadow, cart->prg_ram, SRAM_SIZE);
+
+  pthread_condattr_t ca;
+  pthread_condattr_init(&ca);
+  pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+  pthread_cond_init(&s->cond, &ca);
+  pthread_condattr_destroy(&ca);
+  pthread_mutex_init(&s->lock, NULL);
+  if (pthread_create(&s->thread, NULL, writer_main, s) != 0) {
+    if (err && err_cap) snprintf(err, err_cap, "failed to start save writer thread");
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    return false;
+  }
+  return true;
+}
+
+void sram_poll(sram_saver_t *s, cart_t *cart) {
+  uint32_t dirty = cart->prg_ram_dirty;
+  if (NES_LIKELY(dirty == 0)) return;
+  cart->prg_ram_dirty = 0;
+  pthread_mutex_lock(&s->lock);
+  // Many games rewrite the same values every frame (checksums, counters that
+  // did not move); only pages whose bytes differ from the shadow count.
+  bool changed = false;
+  for (int page = 0; page < SRAM_SIZE / SRAM_PAGE; page++) {
+    if (!(dirty & (1u << page))) continue;
+    uint8_t *dst = s->shadow + page * SRAM_PAGE;
+    const uint8_t *src = cart->prg_ram + page * SRAM_PAGE;
+    if (memcmp(dst, src, SRAM_PAGE) == 0) continue;
+    memcpy(dst, src, SRAM_PAGE);
+    changed = true;
+  }
+  if (!changed) {
+    pthread_mutex_unlock(&s->lock);
+    return;
+  }
+  s->last_change = now_ms();
+  if (!s->pending) s->first_change = s->last_change;
+  s->pending = true;
+  pthread_cond_signal(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+}
+
+bool sram_close(sram_saver_t *s, char *err, size_t err_cap) {
+  pthread_mutex_lock(&s->lock);
+  s->stop = true;
+  pthread_cond_signal(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  pthread_cond_destroy(&s->cond);
+  pthread_mutex_destroy(&s->lock);
+  if (s->write_failed) {
+    if (err && err_cap) snprintf(err, err_cap, "failed writing %s", s->path);
+    return false;
+  }
+  return true;
+}
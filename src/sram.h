@@ -0,0 +1,35 @@
+#pragma once
+#include "common.h"
+#include "ines.h"
+#include <pthread.h>
+
+// Battery-backed PRG RAM persistence. The emulation thread only copies the
+// 256-byte pages the game dirtied and actually changed into a shadow buffer
+// (sram_poll, once per frame); a writer thread saves the shadow once writes
+// have been quiet for `quiet_ms` (or have kept going for SRAM_MAX_DELAY_MS),
+// and on close, via write-to-temp-then-rename plus a directory fsync.
+enum { SRAM_MAX_DELAY_MS = 10000 };
+
+typedef struct sram_saver {
+  char path[1024];
+  char tmp_path[1040];
+  uint32_t quiet_ms;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint8_t shadow[8192];
+  bool pending;         // shadow has changes not yet on disk
+  uint64_t first_change; // monotonic ms when the shadow became pending
+  uint64_t last_change;  // monotonic ms of the last sram_poll that found changed pages
+  bool stop;
+  bool write_failed;
+  uint32_t saves;
+} sram_saver_t;
+
+// Reads `path` into the cart's PRG RAM if it exists (a missing file is not an error).
+bool sram_load(cart_t *cart, const char *path, char *err, size_t err_cap);
+bool sram_open(sram_saver_t *s, const cart_t *cart, const char *path, uint32_t quiet_ms, char *err, size_t err_cap);
+void sram_poll(sram_saver_t *s, cart_t *cart);
+// Flushes anything pending and stops the writer; false if a save failed.
+bool sram_close(sram_saver_t *s, char *err, size_t err_cap);
@@ -0,0 +1,70 @@
+#include "trace.h"
+#include "nes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool trace_init(trace_t *t, uint32_t cap_records) {
+  memset(t, 0, sizeof(*t));
+  uint32_t cap = 1;
+  while (cap < cap_records && cap < (1u << 30)) cap <<= 1;
+  t->rec = (trace_record_t *)calloc(cap, sizeof(trace_record_t));
+  if (!t->rec) return false;
+  t->cap = cap;
+  return true;
+}
+
+void trace_free(trace_t *t) {
+  if (!t) return;
+  free(t->rec);
+  memset(t, 0, sizeof(*t));
+}
+
+void trace_instruction(trace_t *t, struct nes *nes) {
+  nes_t *n = (nes_t *)nes;
+  const cpu6502_t *c = &n->cpu;
+  trace_record_t *r = &t->rec[t->total++ & (t->cap - 1)];
+  uint8_t op = nes_cpu_peek(n, c->pc);
+  r->cycles = c->cycles;
+  r->pc = c->pc;
+  r->len = (uint8_t)cpu6502_op_length(op);
+  r->bytes[0] = op;
+  r->bytes[1] = (r->len > 1) ? nes_cpu_peek(n, (uint16_t)(c->pc + 1)) : 0;
+  r->bytes[2] = (r->len > 2) ? nes_cpu_peek(n, (uint16_t)(c->pc + 2)) : 0;
+  r->a = c->a;
+  r->x = c->x;
+  r->y = c->y;
+  r->p = cpu6502_get_p(c);
+  r->sp = c->sp;
+  r->pad = 0;
+  int scanline = 0, dot = 0;
+  nes_ppu_position(n, &scanline, &dot);
+  r->scanline = (int16_t)scanline;
+  r->dot = (uint16_t)dot;
+}
+
+bool trace_save(const trace_t *t, const char *path, char *err, size_t err_cap) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    if (err && err_cap) snprintf(err, err_cap, "failed to open %s", path);
+    return false;
+  }
+  uint64_t count = (t->total < t->cap) ? t->total : t->cap;
+  trace_file_header_t h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+  h.record_size = (uint32_t)sizeof(trace_record_t);
+  h.count = (uint32_t)count;
+  h.total = t->total;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+
+  // Oldest record first: once the ring has wrapped it sits at the write index.
+  uint64_t first = t->total - count;
+  uint32_t start = (uint32_t)(first & (t->cap - 1));
+  uint32_t n1 = (uint32_t)((count < (uint64_t)(t->cap - start)) ? count : (t->cap - start));
+  if (ok && n1) ok = fwrite(&t->rec[start], sizeof(trace_record_t), n1, f) == n1;
+  if (ok && count > n1) ok = fwrite(&t->rec[0], sizeof(trace_record_t), (size_t)(count - n1), f) == (size_t)(count - n1);
+  if (fclose(f) != 0) ok = false;
+  if (!ok && err && err_cap) snprintf(err, err_cap, "failed writing %s", path);
+  return ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "common.h"
+
+struct nes;
+
+// One fixed-size record per executed instruction, captured before it executes.
+typedef struct {
+  uint64_t cycles;
+  uint16_t pc;
+  uint8_t bytes[3]; // opcode + operand bytes (only `len` are meaningful)
+  uint8_t len;
+  uint8_t a, x, y, p, sp;
+  uint8_t pad;
+  int16_t scanline;
+  uint16_t dot;
+} trace_record_t;
+
+_Static_assert(sizeof(trace_record_t) == 24, "trace records are a fixed 24-byte on-disk format");
+
+// Binary trace file: header followed by `count` records, oldest first.
+// Fields are stored in host byte order (little-endian on every supported host).
+#define TRACE_FILE_MAGIC "NESTRC1"
+
+typedef struct {
+  char magic[8];
+  uint32_t record_size;
+  uint32_t count;
+  uint64_t total; // records produced during the run (>= count if the ring wrapped)
+} trace_file_header_t;
+
+// Preallocated ring buffer; the newest `cap` records survive.
+typedef struct trace {
+  trace_record_t *rec;
+  uint32_t cap; // power of two
+  uint64_t total;
+} trace_t;
+
+bool trace_init(trace_t *t, uint32_t cap_records);
+void trace_free(trace_t *t);
+bool trace_save(const trace_t *t, const char *path, char *err, size_t err_cap);
+
+// Hot path: called by the CPU core before each instruction when tracing is on.
+void trace_instruction(trace_t *t, struct nes *nes);
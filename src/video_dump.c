@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+#include "video_dump.h"
+#include "ppu.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum { W = 256, H = 240 };
+
+static uint8_t clamp_u8(int v) { return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+static bool write_index_frame(FILE *f, const video_dump_frame_t *fr) {
+  return fwrite(fr->index, sizeof(fr->index), 1, f) == 1 && fwrite(fr->emphasis, sizeof(fr->emphasis), 1, f) == 1;
+}
+
+static bool write_y4m_frame(FILE *f, const uint32_t *palette, const video_dump_frame_t *fr) {
+  // Convert the palette entries once, then the planes are table lookups
+  // (index | line emphasis << 6).
+  uint8_t py[PALETTE_SIZE];
+  int pu[PALETTE_SIZE], pv[PALETTE_SIZE];
+  for (int i = 0; i < PALETTE_SIZE; i++) {
+    int r = (int)((palette[i] >> 16) & 0xFF);
+    int g = (int)((palette[i] >> 8) & 0xFF);
+    int b = (int)(palette[i] & 0xFF);
+    py[i] = clamp_u8((77 * r + 150 * g + 29 * b + 128) >> 8);
+    pu[i] = (-43 * r - 85 * g + 128 * b) + 128 * 256;
+    pv[i] = (128 * r - 107 * g - 21 * b) + 128 * 256;
+  }
+
+  static const char hdr[] = "FRAME\n";
+  uint8_t y[W * H];
+  uint8_t u[(W / 2) * (H / 2)], v[(W / 2) * (H / 2)];
+  for (int row = 0; row < H; row++) {
+    int e = (fr->emphasis[row] & 7) << 6;
+    for (int i = row * W; i < (row + 1) * W; i++) y[i] = py[e | (fr->index[i] & 63)];
+  }
+  for (int cy = 0; cy < H / 2; cy++) {
+    const uint8_t *r0 = &fr->index[(cy * 2) * W];
+    const uint8_t *r1 = r0 + W;
+    int e0 = (fr->emphasis[cy * 2] & 7) << 6, e1 = (fr->emphasis[cy * 2 + 1] & 7) << 6;
+    for (int cx = 0; cx < W / 2; cx++) {
+      int a = e0 | (r0[cx * 2] & 63), b = e0 | (r0[cx * 2 + 1] & 63);
+      int c = e1 | (r1[cx * 2] & 63), d = e1 | (r1[cx * 2 + 1] & 63);
+      u[cy * (W / 2) + cx] = clamp_u8((pu[a] + pu[b] + pu[c] + pu[d] + 512) >> 10);
+      v[cy * (W / 2) + cx] = clamp_u8((pv[a] + pv[b] + pv[c] + pv[d] + 512) >> 10);
+    }
+  }
+  return fwrite(hdr, sizeof(hdr) - 1, 1, f) == 1 && fwrite(y, sizeof(y), 1, f) == 1 &&
+         fwrite(u, sizeof(u), 1, f) == 1 && fwrite(v, sizeof(v), 1, f) == 1;
+}
+
+static void *writer_main(void *arg) {
+  video_dump_t *d = (video_dump_t *)arg;
+  for (;;) {
+    pthread_mutex_lock(&d->lock);
+    while (d->count == 0 && !d->closing) pthread_cond_wait(&d->not_empty, &d->lock);
+    if (d->count == 0) {
+      pthread_mutex_unlock(&d->lock);
+      return NULL;
+    }
+    const video_dump_frame_t *fr = &d->queue[d->tail];
+    pthread_mutex_unlock(&d->lock);
+
+    bool ok = (d->format == VIDEO_DUMP_Y4M) ? write_y4m_frame(d->f, d->palette, fr) : write_index_frame(d->f, fr);
+
+    pthread_mutex_lock(&d->lock);
+    if (!ok) d->write_failed = true;
+    d->tail = (d->tail + 1) % VIDEO_DUMP_QUEUE;
+    d->count--;
+    pthread_cond_signal(&d->not_full);
+    pthread_mutex_unlock(&d->lock);
+  }
+}
+
+bool video_dump_open(video_dump_t *d, const char *path, video_dump_format_t format, const uint32_t *palette,
+                     char *err, size_t err_cap) {
+  memset(d, 0, sizeof(*d));
+  d->format = format;
+  memcpy(d->palette, palette, sizeof(d->palette));
+  d->f = fopen(path, "wb");
+  if (!d->f) {
+    if (err && err_cap) snprintf(err, err_cap, "failed to open %s", path);
+    return false;
+  }
+  bool ok;
+  if (format == VIDEO_DUMP_Y4M) {
+    // Exact NTSC NES frame rate: 39375000 / 655171 (~60.0988 Hz).
+    ok = fprintf(d->f, "YUV4MPEG2 W%d H%d F39375000:655171 Ip A8:7 C420jpeg\n", W, H) > 0;
+  } else {
+    uint8_t hdr[12 + PALETTE_SIZE * 3] = { 0 };
+    memcpy(hdr, VIDEO_DUMP_INDEX_MAGIC, sizeof(VIDEO_DUMP_INDEX_MAGIC));
+    hdr[8] = W & 0xFF; hdr[9] = W >> 8;
+    hdr[10] = H & 0xFF; hdr[11] = H >> 8;
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+      hdr[12 + i * 3 + 0] = (uint8_t)(palette[i] >> 16);
+      hdr[12 + i * 3 + 1] = (uint8_t)(palette[i] >> 8);
+      hdr[12 + i * 3 + 2] = (uint8_t)palette[i];
+    }
+    ok = fwrite(hdr, sizeof(hdr), 1, d->f) == 1;
+  }
+  d->queue = (video_dump_frame_t *)malloc(sizeof(video_dump_frame_t) * VIDEO_DUMP_QUEUE);
+  if (!ok || !d->queue) {
+    if (err && err_cap) snprintf(err, err_cap, ok ? "oom video queue" : "failed writing %s", path);
+    free(d->queue);
+    fclose(d->f);
+    return false;
+  }
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->not_empty, NULL);
+  pthread_cond_init(&d->not_full, NULL);
+  if (pthread_create(&d->thread, NULL, writer_main, d) != 0) {
+    if (err && err_cap) snprintf(err, err_cap, "failed to start video writer thread");
+    pthread_cond_destroy(&d->not_full);
+    pthread_cond_destroy(&d->not_empty);
+    pthread_mutex_destroy(&d->lock);
+    free(d->queue);
+    fclose(d->f);
+    return false;
+  }
+  return true;
+}
+
+bool video_dump_frame(video_dump_t *d, const struct ppu *ppu) {
+  pthread_mutex_lock(&d->lock);
+  while (d->count == VIDEO_DUMP_QUEUE) pthread_cond_wait(&d->not_full, &d->lock);
+  bool failed = d->write_failed;
+  video_dump_frame_t *fr = &d->queue[d->head];
+  pthread_mutex_unlock(&d->lock);
+  if (failed) return false;
+
+  // The slot at head is not visible to the writer until count is bumped.
+  memcpy(fr->index, ppu->pixel_index, sizeof(fr->index));
+  memcpy(fr->emphasis, ppu->line_emphasis, sizeof(fr->emphasis));
+
+  pthread_mutex_lock(&d->lock);
+  d->head = (d->head + 1) % VIDEO_DUMP_QUEUE;
+  d->count++;
+  d->frames++;
+  pthread_cond_signal(&d->not_empty);
+  pthread_mutex_unlock(&d->lock);
+  return true;
+}
+
+bool video_dump_close(video_dump_t *d, char *err, size_t err_cap) {
+  pthread_mutex_lock(&d->lock);
+  d->closing = true;
+  pthread_cond_signal(&d->not_empty);
+  pthread_mutex_unlock(&d->lock);
+  pthread_join(d->thread, NULL);
+
+  bool ok = !d->write_failed;
+  if (fclose(d->f) != 0) ok = false;
+  if (!ok && err && err_cap) snprintf(err, err_cap, "failed writing video stream");
+  pthread_cond_destroy(&d->not_full);
+  pthread_cond_destroy(&d->not_empty);
+  pthread_mutex_destroy(&d->lock);
+  free(d->queue);
+  d->queue = NULL;
+  d->f = NULL;
+  return ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "common.h"
+#include "palette.h"
+#include <pthread.h>
+#include <stdio.h>
+
+struct ppu;
+
+typedef enum {
+  VIDEO_DUMP_INDEX = 0, // raw: 1 index byte per pixel + 1 emphasis byte per line
+  VIDEO_DUMP_Y4M = 1,   // YUV4MPEG2, 4:2:0, full-range BT.601
+} video_dump_format_t;
+
+// Index stream layout: "NESIDX2\0", u16 width, u16 height (little-endian) and
+// the 512-entry palette as RGB (PALETTE_SIZE * 3 bytes), then per frame
+// width * height indices followed by height emphasis bytes (PPUMASK bits 5-7,
+// >> 5). A pixel's colour is palette[emphasis[y] << 6 | index].
+#define VIDEO_DUMP_INDEX_MAGIC "NESIDX2"
+
+enum { VIDEO_DUMP_QUEUE = 8 };
+
+typedef struct {
+  uint8_t index[256 * 240];
+  uint8_t emphasis[240];            // per line, PPUMASK bits 5-7
+} video_dump_frame_t;
+
+// Frames are copied into a bounded queue and converted/written by a
+// background thread; video_dump_frame() blocks while the queue is full.
+typedef struct video_dump {
+  FILE *f;
+  video_dump_format_t format;
+  uint32_t palette[PALETTE_SIZE]; // fixed for the whole stream
+  video_dump_frame_t *queue;
+  int head, tail, count;
+  bool closing;
+  bool write_failed;
+  uint64_t frames;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty, not_full;
+} video_dump_t;
+
+// `palette` (PALETTE_SIZE entries) colours every frame of the stream.
+bool video_dump_open(video_dump_t *d, const char *path, video_dump_format_t format, const uint32_t *palette,
+                     char *err, size_t err_cap);
+bool video_dump_frame(video_dump_t *d, const struct ppu *ppu);
+// Drains the queue and closes the file; false if any write failed.
+bool video_dump_close(video_dump_t *d, char *err, size_t err_cap);
@@ -0,0 +1,529 @@
+// Regression runner: executes the ROM tests listed in a manifest in parallel
+// and checks framebuffer hashes, RAM bytes, the blargg $6000 result protocol
+// the hang detector's verdict or an upscaling filter's output.
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall()
+#include "../src/filter.h"
+#include "../src/freeze.h"
+#include "../src/nes.h"
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+enum { MAX_TESTS = 256, MAX_INPUTS = 16, MAX_RAM_CHECKS = 8, MAX_RAM_BYTES = 16 };
+
+typedef struct {
+  uint8_t buttons;
+  int from, to; // frames [from, to)
+} input_event_t;
+
+typedef struct {
+  uint16_t addr;
+  uint8_t bytes[MAX_RAM_BYTES];
+  int len;
+} ram_check_t;
+
+typedef enum { RESULT_PASS, RESULT_FAIL, RESULT_SKIP } result_t;
+
+// Hardware counters for --counters: L1D read misses, last-level cache read
+// misses, retired instructions. Counted per worker thread around each test.
+enum { COUNTER_L1D, COUNTER_LLC, COUNTER_INSNS, COUNTER_COUNT };
+
+typedef struct {
+  char name[64];
+  char rom[256];
+  int frames;
+  bool has_hash;
+  uint32_t hash;
+  bool blargg;
+  ppu_render_mode_t ppu_mode;
+  ram_check_t ram[MAX_RAM_CHECKS];
+  int ram_count;
+  input_event_t input[MAX_INPUTS];
+  int input_count;
+  uint32_t freeze_window; // 0 = no hang check
+  bool expect_freeze;
+  bool has_filter;
+  filter_kind_t filter;
+  uint32_t filter_hash;
+  char expect_fail[64]; // non-empty: the checks must fail with this in the detail
+
+  result_t result;
+  char detail[288];
+  int frames_run;
+  double seconds;
+  bool has_counters;
+  uint64_t counters[COUNTER_COUNT];
+} test_t;
+
+static test_t tests[MAX_TESTS];
+static int test_count;
+static atomic_int next_test;
+static bool use_counters;
+static atomic_int counters_errno;
+
+static uint32_t fnv1a32(const void *data, size_t n) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+#ifdef __linux__
+static int open_counter(int i) {
+  struct perf_event_attr a;
+  memset(&a, 0, sizeof(a));
+  a.size = sizeof(a);
+  a.exclude_kernel = 1;
+  a.exclude_hv = 1;
+  if (i == COUNTER_INSNS) {
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = PERF_COUNT_HW_INSTRUCTIONS;
+  } else {
+    a.type = PERF_TYPE_HW_CACHE;
+    a.config = (i == COUNTER_L1D ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_LL) |
+               (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+  // pid 0, cpu -1: this thread only, on any CPU. Counting starts right away.
+  return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+#endif
+
+// Opens the calling thread's counters; false when the kernel or VM does not
+// expose them (the reason is kept for the summary).
+static bool counters_open(int fds[COUNTER_COUNT]) {
+  bool ok = true;
+  for (int i = 0; i < COUNTER_COUNT; i++) {
+    fds[i] = -1;
+#ifdef __linux__
+    if (ok && (fds[i] = open_counter(i)) < 0) {
+      atomic_store(&counters_errno, errno);
+      ok = false;
+    }
+#else
+    atomic_store(&counters_errno, ENOSYS);
+    ok = false;
+#endif
+  }
+  for (int i = 0; i < COUNTER_COUNT && !ok; i++) {
+    if (fds[i] >= 0) close(fds[i]);
+  }
+  return ok;
+}
+
+static void counters_close(int fds[COUNTER_COUNT], test_t *t) {
+  t->has_counters = true;
+  for (int i = 0; i < COUNTER_COUNT; i++) {
+    uint64_t v = 0;
+    if (fds[i] < 0 || read(fds[i], &v, sizeof(v)) != (ssize_t)sizeof(v)) t->has_counters = false;
+    t->counters[i] = v;
+    if (fds[i] >= 0) close(fds[i]);
+  }
+}
+
+static bool parse_buttons(const char *s, size_t len, uint8_t *out) {
+  // NES pad bit order: A, B, Select, Start, Up, Down, Left, Right
+  static const char *names[8] = { "A", "B", "SELECT", "START", "UP", "DOWN", "LEFT", "RIGHT" };
+  *out = 0;
+  while (len > 0) {
+    size_t n = 0;
+    while (n < len && s[n] != '+') n++;
+    bool found = false;
+    for (int b = 0; b < 8; b++) {
+      if (strlen(names[b]) == n && strncasecmp(s, names[b], n) == 0) {
+        *out |= (uint8_t)(1 << b);
+        found = true;
+      }
+    }
+    if (!found) return false;
+    s += n;
+    len -= n;
+    if (len > 0) { s++; len--; }
+  }
+  return true;
+}
+
+// input=BUTTON[+BUTTON...]@FROM[-TO]
+static bool parse_input(test_t *t, const char *v) {
+  if (t->input_count >= MAX_INPUTS) return false;
+  const char *at = strchr(v, '@');
+  if (!at) return false;
+  input_event_t *e = &t->input[t->input_count];
+  if (!parse_buttons(v, (size_t)(at - v), &e->buttons)) return false;
+  char *end = NULL;
+  e->from = (int)strtol(at + 1, &end, 10);
+  e->to = (*end == '-') ? (int)strtol(end + 1, &end, 10) : e->from + 1;
+  if (*end != '\0' || e->to <= e->from) return false;
+  t->input_count++;
+  return true;
+}
+
+// filter=NAME:HASH (hex)
+static bool parse_filter(test_t *t, const char *v) {
+  const char *colon = strchr(v, ':');
+  if (!colon || (size_t)(colon - v) >= 32) return false;
+  char name[32];
+  memcpy(name, v, (size_t)(colon - v));
+  name[colon - v] = '\0';
+  char *end = NULL;
+  t->filter_hash = (uint32_t)strtoul(colon + 1, &end, 16);
+  t->has_filter = end != colon + 1 && *end == '\0' && filter_parse(name, &t->filter);
+  return t->has_filter;
+}
+
+// ram=ADDR:BYTE[,BYTE...] (hex)
+static bool parse_ram(test_t *t, const char *v) {
+  if (t->ram_count >= MAX_RAM_CHECKS) return false;
+  ram_check_t *r = &t->ram[t->ram_count];
+  char *end = NULL;
+  r->addr = (uint16_t)strtoul(v, &end, 16);
+  if (*end != ':') return false;
+  r->len = 0;
+  do {
+    if (r->len >= MAX_RAM_BYTES) return false;
+    const char *p = end + 1;
+    r->bytes[r->len++] = (uint8_t)strtoul(p, &end, 16);
+    if (end == p) return false;
+  } while (*end == ',');
+  if (*end != '\0') return false;
+  t->ram_count++;
+  return true;
+}
+
+static bool parse_manifest(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "failed to open manifest %s\n", path);
+    return false;
+  }
+  char line[1024];
+  int lineno = 0;
+  bool ok = true;
+  while (fgets(line, sizeof(line), f)) {
+    lineno++;
+    char *hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    char *tok = strtok(line, " \t\r\n");
+    if (!tok) continue;
+    if (test_count >= MAX_TESTS) {
+      fprintf(stderr, "%s:%d: too many tests\n", path, lineno);
+      ok = false;
+      break;
+    }
+    test_t *t = &tests[test_count];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->name, sizeof(t->name), "%s", tok);
+    char *rom = strtok(NULL, " \t\r\n");
+    char *frames = strtok(NULL, " \t\r\n");
+    if (!rom || !frames || atoi(frames) <= 0) {
+      fprintf(stderr, "%s:%d: expected <name> <rom> <frames> [checks...]\n", path, lineno);
+      ok = false;
+      continue;
+    }
+    snprintf(t->rom, sizeof(t->rom), "%s", rom);
+    t->frames = atoi(frames);
+
+    bool line_ok = true;
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+      if (strncmp(tok, "hash=", 5) == 0) {
+        char *end;
+        t->has_hash = true;
+        t->hash = (uint32_t)strtoul(tok + 5, &end, 16);
+        line_ok = end == tok + 13 && *end == '\0' && strspn(tok + 5, "0123456789abcdefABCDEF") == 8 && line_ok;
+      } else if (strncmp(tok, "expect-fail=", 12) == 0) {
+        snprintf(t->expect_fail, sizeof(t->expect_fail), "%s", tok + 12);
+        for (char *c = t->expect_fail; *c; c++) {
+          if (*c == '_') *c = ' ';
+        }
+        line_ok = t->expect_fail[0] != '\0' && line_ok;
+      } else if (strncmp(tok, "ram=", 4) == 0) {
+        line_ok = parse_ram(t, tok + 4) && line_ok;
+      } else if (strncmp(tok, "filter=", 7) == 0) {
+        line_ok = parse_filter(t, tok + 7) && line_ok;
+      } else if (strncmp(tok, "input=", 6) == 0) {
+        line_ok = parse_input(t, tok + 6) && line_ok;
+      } else if (strncmp(tok, "freeze=", 7) == 0 || strncmp(tok, "no-freeze=", 10) == 0) {
+        t->expect_freeze = tok[0] == 'f';
+        t->freeze_window = (uint32_t)atoi(strchr(tok, '=') + 1);
+        line_ok = t->freeze_window > 0 && line_ok;
+      } else if (strcmp(tok, "blargg") == 0) {
+        t->blargg = true;
+      } else if (strcmp(tok, "ppu=accurate") == 0) {
+        t->ppu_mode = PPU_RENDER_ACCURATE;
+      } else if (strcmp(tok, "ppu=fast") == 0) {
+        t->ppu_mode = PPU_RENDER_FAST;
+      } else {
+        line_ok = false;
+      }
+      if (!line_ok) {
+        fprintf(stderr, "%s:%d: bad field '%s'\n", path, lineno, tok);
+        break;
+      }
+    }
+    if (!line_ok) {
+      ok = false;
+      continue;
+    }
+    if (!t->has_hash && !t->blargg && t->ram_count == 0 && t->freeze_window == 0 && !t->has_filter) {
+      fprintf(stderr, "%s:%d: test '%s' has no checks\n", path, lineno, t->name);
+      ok = false;
+      continue;
+    }
+    test_count++;
+  }
+  fclose(f);
+  return ok;
+}
+
+static uint8_t input_for_frame(const test_t *t, int frame) {
+  uint8_t pad = 0;
+  for (int i = 0; i < t->input_count; i++) {
+    if (frame >= t->input[i].from && frame < t->input[i].to) pad |= t->input[i].buttons;
+  }
+  return pad;
+}
+
+static bool blargg_signature(const nes_t *nes) {
+  return nes_cpu_peek(nes, 0x6001) == 0xDE && nes_cpu_peek(nes, 0x6002) == 0xB0 &&
+         nes_cpu_peek(nes, 0x6003) == 0x61;
+}
+
+static void blargg_message(const nes_t *nes, char *out, size_t cap) {
+  size_t n = 0;
+  for (uint16_t a = 0x6004; a < 0x8000 && n + 1 < cap; a++) {
+    uint8_t ch = nes_cpu_peek(nes, a);
+    if (ch == 0) break;
+    out[n++] = (ch == '\n' || !isprint(ch)) ? ' ' : (char)ch;
+  }
+  while (n > 0 && out[n - 1] == ' ') n--;
+  out[n] = '\0';
+}
+
+// Draws the last frame through the test's filter twice, with one band and
+// with four, each from a fresh filter_t: both must hash to the expected value,
+// so band seams or per-thread state show up as a failure.
+static void check_filter(test_t *t, const nes_t *nes) {
+  static const int threads[2] = { 1, 4 };
+  int pitch = filter_width(t->filter) * (int)sizeof(uint32_t);
+  size_t size = (size_t)pitch * (size_t)filter_height(t->filter);
+  uint32_t *out = (uint32_t *)malloc(size);
+  filter_t *f = (filter_t *)malloc(sizeof(*f));
+  char err[128] = {0};
+  for (int i = 0; i < 2 && t->result == RESULT_PASS; i++) {
+    if (!out || !f || !filter_init(f, threads[i], nes->palette, err, sizeof(err))) {
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "filter init failed: %s", out && f ? err : "oom");
+      break;
+    }
+    memset(out, 0, size);
+    // nes --headless filters every frame and the NTSC filters alternate the
+    // burst field each time; draw the field its last frame used.
+    filter_set_field(f, (unsigned)(t->frames_run - 1));
+    bool drawn = filter_run(f, t->filter, nes->ppu.pixel_index, nes->ppu.line_emphasis, out, pitch);
+    filter_free(f);
+    if (!drawn) {
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "filter=%s: out of memory", filter_name(t->filter));
+      break;
+    }
+    uint32_t h = fnv1a32(out, size);
+    if (h != t->filter_hash) {
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "filter=%s with %d threads: filter_fnv1a32=%08x, expected %08x",
+               filter_name(t->filter), threads[i], h, t->filter_hash);
+    }
+  }
+  free(f);
+  free(out);
+}
+
+static void run_test(test_t *t) {
+  double start = now_seconds();
+  FILE *probe = fopen(t->rom, "rb");
+  if (!probe) {
+    t->result = RESULT_SKIP;
+    snprintf(t->detail, sizeof(t->detail), "ROM not found: %s", t->rom);
+    return;
+  }
+  fclose(probe);
+
+  nes_t *nes = (nes_t *)malloc(sizeof(*nes));
+  char err[256] = {0};
+  if (!nes || !nes_load(nes, t->rom, err, sizeof(err))) {
+    t->result = RESULT_FAIL;
+    snprintf(t->detail, sizeof(t->detail), "load failed: %s", nes ? err : "oom");
+    free(nes);
+    return;
+  }
+  ppu_set_render_mode(&nes->ppu, t->ppu_mode);
+
+  // blargg protocol: $6000 = $80 while running, $81 = press reset after
+  // >100ms, otherwise the result code; $6001-$6003 = DE B0 61 once valid.
+  int reset_at = -1;
+  bool blargg_done = false;
+  int frame = 0;
+  freeze_detector_t freeze;
+  freeze_init(&freeze, t->freeze_window);
+  int frozen_at = -1;
+  int fds[COUNTER_COUNT];
+  bool counting = use_counters && counters_open(fds);
+  for (; frame < t->frames; frame++) {
+    nes_set_pad(nes, 0, input_for_frame(t, frame));
+    (void)nes_run_frame(nes, 200000);
+    if (t->freeze_window && frozen_at < 0 && freeze_frame(&freeze, (struct nes *)nes)) frozen_at = frame;
+    if (!t->blargg || !blargg_signature(nes)) continue;
+    uint8_t status = nes_cpu_peek(nes, 0x6000);
+    if (status == 0x81 && reset_at < 0) {
+      reset_at = frame + 8;
+    } else if (status < 0x80) {
+      blargg_done = true;
+      frame++;
+      break;
+    }
+    if (frame == reset_at) {
+      nes_reset(nes);
+      reset_at = -1;
+    }
+  }
+  t->frames_run = frame;
+  if (counting) counters_close(fds, t);
+
+  t->result = RESULT_PASS;
+  if (t->blargg) {
+    char msg[160];
+    blargg_message(nes, msg, sizeof(msg));
+    uint8_t status = nes_cpu_peek(nes, 0x6000);
+    if (!blargg_done) {
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "no blargg result after %d frames", frame);
+    } else if (status != 0) {
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "result $%02X: %s", status, msg);
+    }
+  }
+  if (t->freeze_window && t->result == RESULT_PASS && (frozen_at >= 0) != t->expect_freeze) {
+    t->result = RESULT_FAIL;
+    if (frozen_at >= 0) snprintf(t->detail, sizeof(t->detail), "hang detected at frame %d", frozen_at);
+    else snprintf(t->detail, sizeof(t->detail), "no hang detected in %d frames", frame);
+  }
+  for (int i = 0; i < t->ram_count && t->result == RESULT_PASS; i++) {
+    const ram_check_t *r = &t->ram[i];
+    for (int k = 0; k < r->len; k++) {
+      uint16_t a = (uint16_t)(r->addr + k);
+      uint8_t got = nes_cpu_peek(nes, a);
+      if (got != r->bytes[k]) {
+        t->result = RESULT_FAIL;
+        snprintf(t->detail, sizeof(t->detail), "$%04X = %02X, expected %02X", a, got, r->bytes[k]);
+        break;
+      }
+    }
+  }
+  if (t->has_hash && t->result == RESULT_PASS) {
+    uint32_t h = fnv1a32(nes->ppu.framebuffer, PPU_PIXELS * sizeof(uint32_t));
+    if (h != t->hash) {
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "framebuffer_fnv1a32=%08x, expected %08x", h, t->hash);
+    }
+  }
+  if (t->has_filter && t->result == RESULT_PASS) check_filter(t, nes);
+  if (t->expect_fail[0]) {
+    if (t->result == RESULT_FAIL && strstr(t->detail, t->expect_fail)) {
+      t->result = RESULT_PASS;
+    } else {
+      char got[sizeof(t->detail)];
+      snprintf(got, sizeof(got), "%s", t->result == RESULT_PASS ? "passed" : t->detail);
+      t->result = RESULT_FAIL;
+      snprintf(t->detail, sizeof(t->detail), "expected a failure with \"%s\", got: %.180s", t->expect_fail, got);
+    }
+  }
+
+  nes_free(nes);
+  free(nes);
+  t->seconds = now_seconds() - start;
+}
+
+static void *worker(void *arg) {
+  (void)arg;
+  for (;;) {
+    int i = atomic_fetch_add(&next_test, 1);
+    if (i >= test_count) return NULL;
+    run_test(&tests[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *manifest = "tests/manifest.txt";
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--counters") == 0) {
+      use_counters = true;
+    } else if (argv[i][0] != '-') {
+      manifest = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [-j <threads>] [--counters] [manifest]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!parse_manifest(manifest)) return 2;
+  if (jobs < 1) jobs = 1;
+  if (jobs > test_count) jobs = test_count > 0 ? test_count : 1;
+
+  double start = now_seconds();
+  pthread_t threads[64];
+  int nthreads = (jobs > 64) ? 64 : (int)jobs;
+  int started = 0;
+  for (; started < nthreads; started++) {
+    if (pthread_create(&threads[started], NULL, worker, NULL) != 0) break;
+  }
+  if (started == 0) worker(NULL);
+  for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+  double elapsed = now_seconds() - start;
+
+  int passed = 0, failed = 0, skipped = 0;
+  for (int i = 0; i < test_count; i++) {
+    const test_t *t = &tests[i];
+    static const char *labels[] = { "PASS", "FAIL", "SKIP" };
+    if (t->result == RESULT_SKIP) {
+      printf("%s  %-24s %s\n", labels[t->result], t->name, t->detail);
+    } else {
+      printf("%s  %-24s %5d frames %7.3fs%s%s\n", labels[t->result], t->name, t->frames_run,
+             t->seconds, t->detail[0] ? "  " : "", t->detail);
+      if (t->has_counters && t->frames_run > 0) {
+        double f = (double)t->frames_run;
+        printf("      per frame: %.0f L1D read misses, %.0f LLC read misses, %.0f instructions\n",
+               (double)t->counters[COUNTER_L1D] / f, (double)t->counters[COUNTER_LLC] / f,
+               (double)t->counters[COUNTER_INSNS] / f);
+      }
+    }
+    if (t->result == RESULT_PASS) passed++;
+    else if (t->result == RESULT_FAIL) failed++;
+    else skipped++;
+  }
+  int counter_err = atomic_load(&counters_errno);
+  if (use_counters && counter_err) printf("hardware counters unavailable: %s\n", strerror(counter_err));
+  printf("%d passed, %d failed, %d skipped in %.3fs (%d threads)\n", passed, failed, skipped, elapsed,
+         started > 0 ? started : 1);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+// Unit tests for the pieces the ROM manifest cannot reach: cheat code
+// decoding and RAM cheats, every RAM search filter on crafted memory, and the
+// ROM database overriding a wrong header.
+#include "../src/cheat.h"
+#include "../src/ines.h"
+#include "../src/nes.h"
+#include "../src/ramsearch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures;
+
+#define CHECK(cond, ...)                                                   \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      failures++;                                                          \
+      printf("FAIL  %s:%d: ", __FILE__, __LINE__);                         \
+      printf(__VA_ARGS__);                                                 \
+      printf("\n");                                                        \
+    }                                                                      \
+  } while (0)
+
+// NROM with 16KB of NOPs: enough for the CPU bus, RAM and PRG RAM.
+static bool load_blank(nes_t *n) {
+  static uint8_t rom[16 + 16384 + 8192];
+  memset(rom, 0, sizeof(rom));
+  memcpy(rom, "NES\x1a\x01\x01", 6);
+  memset(rom + 16, 0xEA, 16384);
+  char err[128];
+  if (!nes_load_mem(n, rom, sizeof(rom), err, sizeof(err))) {
+    printf("FAIL  load: %s\n", err);
+    failures++;
+    return false;
+  }
+  return true;
+}
+
+static void test_cheat_parse(void) {
+  static const struct {
+    const char *code;
+    uint16_t addr;
+    int compare;
+    uint8_t value;
+  } cases[] = {
+    { "SXIOPO", 0x91D9, -1, 0xAD },
+    { "sxiopo", 0x91D9, -1, 0xAD },
+    { "ZEXPYGLA", 0x94A7, 0x03, 0x02 },
+    { "075A:09", 0x075A, -1, 0x09 },
+    { "94A7?03:02", 0x94A7, 0x03, 0x02 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    cheat_t c;
+    char err[128];
+    bool ok = cheat_parse(cases[i].code, &c, err, sizeof(err));
+    CHECK(ok, "cheat_parse(%s): %s", cases[i].code, err);
+    if (!ok) continue;
+    CHECK(c.addr == cases[i].addr && c.compare == cases[i].compare && c.value == cases[i].value,
+          "%s decoded to %04X?%d:%02X", cases[i].code, c.addr, c.compare, c.value);
+  }
+  static const char *const bad[] = { "SXIOP", "SXIOPOO", "QQQQQQ", "075A", "075A:", "075A?03" };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    cheat_t c;
+    CHECK(!cheat_parse(bad[i], &c, NULL, 0), "cheat_parse(%s) accepted", bad[i]);
+  }
+}
+
+static void test_cheat_ram(nes_t *n) {
+  char err[128];
+  n->ram[0x75A] = 0x02;
+  n->cart.prg_ram[0x10] = 0x05;
+  CHECK(cheat_add((struct nes *)n, "075A:09", err, sizeof(err)), "cheat_add: %s", err);
+  CHECK(cheat_add((struct nes *)n, "6010?03:63", err, sizeof(err)), "cheat_add: %s", err);
+  CHECK(!cheat_add((struct nes *)n, "2002:00", err, sizeof(err)), "cheat on I/O space accepted");
+  CHECK(n->ram[0x75A] == 0x09, "$075A = %02X after the code was added", n->ram[0x75A]);
+  CHECK(n->cart.prg_ram[0x10] == 0x05, "compare code replaced %02X", n->cart.prg_ram[0x10]);
+
+  // The unconditional code holds its value; the compare code fires only on
+  // frames where the byte reads the compare value.
+  n->ram[0x75A] = 0x01;
+  n->cart.prg_ram[0x10] = 0x03;
+  cheat_apply_ram((struct nes *)n);
+  CHECK(n->ram[0x75A] == 0x09, "$075A = %02X, not held", n->ram[0x75A]);
+  CHECK(n->cart.prg_ram[0x10] == 0x63, "$6010 = %02X, compare code did not fire", n->cart.prg_ram[0x10]);
+  n->cart.prg_ram[0x10] = 0x04;
+  cheat_apply_ram((struct nes *)n);
+  CHECK(n->cart.prg_ram[0x10] == 0x04, "$6010 = %02X, compare code ignored its compare", n->cart.prg_ram[0x10]);
+  cheat_clear((struct nes *)n);
+}
+
+static uint8_t *search_byte(nes_t *n, size_t i) {
+  return i < 2048 ? &n->ram[i] : &n->cart.prg_ram[i - 2048];
+}
+
+static bool reference_keep(ramsearch_op_t op, uint8_t cur, uint8_t prev, bool against_value, uint8_t value) {
+  uint8_t rhs = against_value ? value : prev;
+  switch (op) {
+    case RAMSEARCH_EQ: return cur == rhs;
+    case RAMSEARCH_NE: return cur != rhs;
+    case RAMSEARCH_GT: return cur > rhs;
+    case RAMSEARCH_LT: return cur < rhs;
+    case RAMSEARCH_GE: return cur >= rhs;
+    case RAMSEARCH_LE: return cur <= rhs;
+    case RAMSEARCH_CHANGED_BY: return (uint8_t)(cur - prev) == value;
+  }
+  return false;
+}
+
+// Every op, against the previous snapshot and against a constant, on memory
+// where each byte pairs a different old and new value (so every unsigned
+// ordering, equality and wrap-around appears across each 16-byte chunk).
+static void test_ramsearch(nes_t *n) {
+  static const char *const names[] = { "EQ", "NE", "GT", "LT", "GE", "LE", "CHANGED_BY" };
+  static ramsearch_t rs;
+  static uint8_t prev[RAMSEARCH_SIZE];
+  static uint16_t got[RAMSEARCH_SIZE];
+  for (int op = RAMSEARCH_EQ; op <= RAMSEARCH_CHANGED_BY; op++) {
+    for (int against = 0; against < 2; against++) {
+      uint8_t value = op == RAMSEARCH_CHANGED_BY ? 0xFF : 0x80;
+      for (size_t i = 0; i < RAMSEARCH_SIZE; i++) *search_byte(n, i) = prev[i] = (uint8_t)(i * 11 + 5);
+      ramsearch_reset(&rs, (struct nes *)n);
+      for (size_t i = 0; i < RAMSEARCH_SIZE; i++) *search_byte(n, i) = (uint8_t)(i * 37 + (i >> 8));
+
+      uint32_t left = ramsearch_filter(&rs, (struct nes *)n, (ramsearch_op_t)op, against != 0, value);
+      size_t count = ramsearch_results(&rs, got, RAMSEARCH_SIZE);
+      size_t want = 0, k = 0;
+      bool same = count == left;
+      for (size_t i = 0; i < RAMSEARCH_SIZE; i++) {
+        if (!reference_keep((ramsearch_op_t)op, *search_byte(n, i), prev[i], against != 0, value)) continue;
+        uint16_t addr = (uint16_t)(i < 2048 ? i : 0x6000 + (i - 2048));
+        if (k >= count || got[k++] != addr) same = false;
+        want++;
+      }
+      CHECK(same && want == count, "%s %s: %u candidates (%zu listed), expected %zu", names[op],
+            against ? "value" : "previous", left, count, want);
+    }
+  }
+
+  // Filters narrow the previous result: $0010 climbs by one each step.
+  for (size_t i = 0; i < RAMSEARCH_SIZE; i++) *search_byte(n, i) = 0x40;
+  ramsearch_reset(&rs, (struct nes *)n);
+  n->ram[0x10] = 0x41;
+  n->cart.prg_ram[0x1FFF] = 0x41;
+  CHECK(ramsearch_filter(&rs, (struct nes *)n, RAMSEARCH_CHANGED_BY, false, 1) == 2, "changed by 1: two candidates");
+  n->ram[0x10] = 0x42;
+  CHECK(ramsearch_filter(&rs, (struct nes *)n, RAMSEARCH_GT, false, 0) == 1, "greater than before: one candidate");
+  CHECK(ramsearch_results(&rs, got, 4) == 1 && got[0] == 0x0010, "the candidate is $0010");
+  CHECK(ramsearch_filter(&rs, (struct nes *)n, RAMSEARCH_EQ, true, 0x41) == 0, "equal to $41: none left");
+}
+
+// A 32KB PRG + 8KB CHR image whose last four CHR bytes are chosen so the
+// headerless CRC-32 matches the database's Super Mario Bros. entry
+// (3337EC46: mapper 0, vertical mirroring, no battery). The header claims
+// mapper 4, horizontal mirroring and a battery; the lookup must undo all three.
+static void test_romdb_override(void) {
+  static uint8_t rom[16 + 32768 + 8192];
+  memset(rom, 0, sizeof(rom));
+  memcpy(rom, "NES\x1a\x02\x01\x42\x00", 8);
+  memset(rom + 16, 0xEA, 32768);
+  static const uint8_t forge[4] = { 0x48, 0x9A, 0xED, 0x0E };
+  memcpy(rom + sizeof(rom) - 4, forge, 4);
+
+  cart_t cart;
+  char err[128];
+  bool ok = ines_load_mem(&cart, rom, sizeof(rom), err, sizeof(err));
+  CHECK(ok, "ines_load_mem: %s", err);
+  if (!ok) return;
+  CHECK(cart.info.crc32 == 0x3337EC46, "crc32 %08X, expected 3337EC46", cart.info.crc32);
+  CHECK(cart.info.db_match, "no database match");
+  CHECK(cart.info.mapper == 0, "mapper %u, expected 0", cart.info.mapper);
+  CHECK(cart.info.mirror == NES_MIRROR_VERTICAL, "mirror %d, expected vertical", (int)cart.info.mirror);
+  CHECK(!cart.info.has_battery, "battery flag not cleared");
+  cart_free(&cart);
+
+  rom[sizeof(rom) - 1] ^= 1; // one byte off: the header is used as is
+  ok = ines_load_mem(&cart, rom, sizeof(rom), err, sizeof(err));
+  CHECK(ok, "ines_load_mem: %s", err);
+  if (!ok) return;
+  CHECK(!cart.info.db_match && cart.info.mapper == 4 && cart.info.mirror == NES_MIRROR_HORIZONTAL,
+        "unknown dump: db_match %d, mapper %u, mirror %d", cart.info.db_match, cart.info.mapper,
+        (int)cart.info.mirror);
+  cart_free(&cart);
+}
+
+int main(void) {
+  nes_t *n = (nes_t *)calloc(1, sizeof(*n));
+  if (!n || !load_blank(n)) return 1;
+  test_cheat_parse();
+  test_cheat_ram(n);
+  test_ramsearch(n);
+  test_romdb_override();
+  nes_free(n);
+  free(n);
+  printf("%s\n", failures ? "unit tests failed" : "unit tests passed");
+  return failures ? 1 : 0;
+}
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,7 +11,21 @@ typedef struct {
   int label;
 } fixup_t;
 
-enum { L_WAIT1, L_PAL_LOOP, L_ROW_LOOP, L_COL_LOOP, L_MAIN_LOOP, L_COUNT };
+enum { L_WAIT1, L_PAL_LOOP, L_ROW_LOOP, L_COL_LOOP, L_MAIN_LOOP, L_NMI, L_BL_SECOND, L_BL_MSG, L_BL_DONE, L_BL_STORE, L_COUNT };
+
+// What the ROM does once the screen is drawn (test variants for tests/manifest.txt).
+typedef enum {
+  MAIN_IDLE, // jmp to itself, NMI off: RAM never changes
+  MAIN_INC,  // inc $00 / jmp, NMI off: a hang that keeps writing RAM
+  MAIN_NMI,  // idle main loop, NMI on and its handler counts frames in $00
+  // blargg $6000 protocol: the first boot asks for a reset ($81), the boot
+  // after it reports result 0 ("passed") or 2 ("reset check failed")
+  MAIN_BLARGG,
+  MAIN_BLARGG_FAIL,
+} main_mode_t;
+
+// PRG RAM byte the blargg modes set before asking for the reset.
+enum { BLARGG_MARKER = 0x6100 };
 
 static void die(const char *msg) {
   fprintf(stderr, "%s\n", msg);
@@ -57,8 +72,32 @@ static void patch_abs16(uint8_t *prg, size_t pos, uint16_t addr) {
   prg[pos + 1] = (uint8_t)(addr >> 8);
 }
 
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [out.nes] [--mask HEX] [--main idle|inc|nmi|blargg|blargg-fail]\n", argv0);
+  exit(2);
+}
+
 int main(int argc, char **argv) {
-  const char *out_path = (argc >= 2) ? argv[1] : "roms/hello.nes";
+  const char *out_path = "roms/hello.nes";
+  uint8_t mask = 0x0A; // show bg + left 8px
+  main_mode_t mode = MAIN_IDLE;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--mask") == 0 && i + 1 < argc) {
+      mask = (uint8_t)strtoul(argv[++i], NULL, 16);
+    } else if (strcmp(argv[i], "--main") == 0 && i + 1 < argc) {
+      const char *m = argv[++i];
+      if (strcmp(m, "idle") == 0) mode = MAIN_IDLE;
+      else if (strcmp(m, "inc") == 0) mode = MAIN_INC;
+      else if (strcmp(m, "nmi") == 0) mode = MAIN_NMI;
+      else if (strcmp(m, "blargg") == 0) mode = MAIN_BLARGG;
+      else if (strcmp(m, "blargg-fail") == 0) mode = MAIN_BLARGG_FAIL;
+      else usage(argv[0]);
+    } else if (argv[i][0] != '-') {
+      out_path = argv[i];
+    } else {
+      usage(argv[0]);
+    }
+  }
 
   uint8_t header[16] = {0};
   header[0] = 'N'; header[1] = 'E'; header[2] = 'S'; header[3] = 0x1A;
@@ -101,6 +140,11 @@ int main(int argc, char **argv) {
   // Reset routine at $8000
   emit(prg, &pc, 0x78);             // SEI
   emit(prg, &pc, 0xD8);             // CLD
+  bool blargg = mode == MAIN_BLARGG || mode == MAIN_BLARGG_FAIL;
+  if (blargg) {
+    emit(prg, &pc, 0xA9); emit(prg, &pc, 0x80);       // LDA #$80 (running)
+    emit(prg, &pc, 0x8D); emit16(prg, &pc, 0x6000);   // STA $6000
+  }
   emit(prg, &pc, 0xA2); emit(prg, &pc, 0x40);         // LDX #$40
   emit(prg, &pc, 0x8E); emit16(prg, &pc, 0x4017);     // STX $4017
   emit(prg, &pc, 0xA2); emit(prg, &pc, 0xFF);         // LDX #$FF
@@ -152,25 +196,68 @@ int main(int argc, char **argv) {
   emit(prg, &pc, 0x8D); emit16(prg, &pc, 0x2005);     // STA $2005
   emit(prg, &pc, 0x8D); emit16(prg, &pc, 0x2005);     // STA $2005
 
-  // Enable BG
-  emit(prg, &pc, 0xA9); emit(prg, &pc, 0x00);         // LDA #0
+  // Enable BG (and NMI)
+  emit(prg, &pc, 0xA9); emit(prg, &pc, mode == MAIN_NMI ? 0x80 : 0x00); // LDA #ctrl
   emit(prg, &pc, 0x8D); emit16(prg, &pc, 0x2000);     // STA $2000
-  emit(prg, &pc, 0xA9); emit(prg, &pc, 0x0A);         // LDA #show bg + left 8px
+  emit(prg, &pc, 0xA9); emit(prg, &pc, mask);         // LDA #mask
   emit(prg, &pc, 0x8D); emit16(prg, &pc, 0x2001);     // STA $2001
 
+  size_t msg_addr_patch = 0;
+  if (blargg) {
+    emit(prg, &pc, 0xAD); emit16(prg, &pc, BLARGG_MARKER); // LDA marker
+    emit(prg, &pc, 0xC9); emit(prg, &pc, 0xA5);       // CMP #$A5
+    emit_branch(prg, &pc, fixups, &fixup_n, 0xF0, L_BL_SECOND); // BEQ second boot
+    static const uint8_t signature[3] = { 0xDE, 0xB0, 0x61 };
+    for (int i = 0; i < 3; i++) {
+      emit(prg, &pc, 0xA9); emit(prg, &pc, signature[i]); // LDA #sig
+      emit(prg, &pc, 0x8D); emit16(prg, &pc, (uint16_t)(0x6001 + i)); // STA $6001+i
+    }
+    emit(prg, &pc, 0xA9); emit(prg, &pc, 0xA5);       // LDA #$A5
+    emit(prg, &pc, 0x8D); emit16(prg, &pc, BLARGG_MARKER); // STA marker
+    emit(prg, &pc, 0xA9); emit(prg, &pc, 0x81);       // LDA #$81 (press reset)
+    emit_branch(prg, &pc, fixups, &fixup_n, 0xD0, L_BL_STORE); // BNE store (always)
+
+    set_label(labels, L_BL_SECOND, pc);
+    emit(prg, &pc, 0xA2); emit(prg, &pc, 0x00);       // LDX #0
+    set_label(labels, L_BL_MSG, pc);
+    emit(prg, &pc, 0xBD);                              // LDA msg,X
+    msg_addr_patch = pc;
+    emit16(prg, &pc, 0x0000);
+    emit(prg, &pc, 0x9D); emit16(prg, &pc, 0x6004);   // STA $6004,X
+    emit_branch(prg, &pc, fixups, &fixup_n, 0xF0, L_BL_DONE); // BEQ done (terminator copied)
+    emit(prg, &pc, 0xE8);                              // INX
+    emit_branch(prg, &pc, fixups, &fixup_n, 0xD0, L_BL_MSG); // BNE msg
+    set_label(labels, L_BL_DONE, pc);
+    emit(prg, &pc, 0xA9); emit(prg, &pc, mode == MAIN_BLARGG ? 0x00 : 0x02); // LDA #result
+    set_label(labels, L_BL_STORE, pc);
+    emit(prg, &pc, 0x8D); emit16(prg, &pc, 0x6000);   // STA $6000
+  }
+
   set_label(labels, L_MAIN_LOOP, pc);
+  if (mode == MAIN_INC) { emit(prg, &pc, 0xE6); emit(prg, &pc, 0x00); } // INC $00
   emit(prg, &pc, 0x4C); emit16(prg, &pc, (uint16_t)(base + labels[L_MAIN_LOOP])); // JMP main
 
+  if (mode == MAIN_NMI) {
+    set_label(labels, L_NMI, pc);
+    emit(prg, &pc, 0xE6); emit(prg, &pc, 0x00);       // INC $00
+    emit(prg, &pc, 0x40);                               // RTI
+  }
+
   // Place palette data after code (aligned)
   while (pc & 0x0F) emit(prg, &pc, 0xEA); // NOP padding
   uint16_t pal_addr = (uint16_t)(base + pc);
   for (int i = 0; i < 32; i++) emit(prg, &pc, pal[i]);
   patch_abs16(prg, pal_addr_patch, pal_addr);
+  if (blargg) {
+    const char *msg = mode == MAIN_BLARGG ? "passed\n" : "reset check failed\n";
+    patch_abs16(prg, msg_addr_patch, (uint16_t)(base + pc));
+    for (size_t i = 0; i <= strlen(msg); i++) emit(prg, &pc, (uint8_t)msg[i]);
+  }
 
   patch_branches(prg, labels, fixups, fixup_n);
 
   // Vectors at end of 16KB bank (mirrored at $FFFA in CPU space).
-  prg[0x3FFA] = 0x00; prg[0x3FFB] = 0x00; // NMI
+  if (mode == MAIN_NMI) patch_abs16(prg, 0x3FFA, (uint16_t)(base + labels[L_NMI])); // NMI
   prg[0x3FFC] = 0x00; prg[0x3FFD] = 0x80; // RESET -> $8000
   prg[0x3FFE] = 0x00; prg[0x3FFF] = 0x00; // IRQ/BRK
 
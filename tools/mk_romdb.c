@@ -0,0 +1,272 @@
+// Builds src/romdb_table.h (a static open-addressed hash table) from
+// tools/romdb.txt and, optionally, an NES 2.0 XML database (nes20db.xml,
+// whose <rom crc32> is the CRC-32 of PRG + CHR, the same key romdb uses).
+#include "../src/romdb.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  romdb_entry_t e;
+  char name[128];
+} row_t;
+
+static void die_line(const char *path, int line, const char *msg) {
+  fprintf(stderr, "%s:%d: %s\n", path, line, msg);
+  exit(1);
+}
+
+// Bytes -> NES 2.0 shift (64 << n); -1 if not encodable.
+static int size_shift(unsigned long bytes) {
+  if (bytes == 0) return 0;
+  for (int n = 1; n < 16; n++) {
+    if ((64ul << n) == bytes) return n;
+  }
+  return -1;
+}
+
+// Validates one entry and appends it; NULL (with the reason) if it cannot be
+// represented.
+static row_t *add_row(row_t **rows, size_t *count, size_t *cap, unsigned long crc, unsigned long mapper,
+                      unsigned long sub, unsigned long prg_kb, unsigned long chr_kb, const char *mirror,
+                      unsigned long battery, const unsigned long sizes[4], const char *timing, const char **why) {
+  if (mapper > 4095 || sub > 15) return *why = "bad mapper", NULL;
+  if (prg_kb == 0 || prg_kb % 16 || prg_kb / 16 > 0xFFFF) return *why = "prg_kb must be a non-zero multiple of 16", NULL;
+  if (chr_kb % 8 || chr_kb / 8 > 0xFFFF) return *why = "chr_kb must be a multiple of 8", NULL;
+  romdb_entry_t e;
+  memset(&e, 0, sizeof(e));
+  e.crc32 = (uint32_t)crc;
+  e.mapper = (uint16_t)mapper;
+  e.submapper = (uint8_t)sub;
+  e.flags = (uint8_t)(ROMDB_F_USED | (battery ? ROMDB_F_BATTERY : 0));
+  e.prg_rom_16k = (uint16_t)(prg_kb / 16);
+  e.chr_rom_8k = (uint16_t)(chr_kb / 8);
+  uint8_t *shifts[4] = { &e.prg_ram_shift, &e.prg_nvram_shift, &e.chr_ram_shift, &e.chr_nvram_shift };
+  for (int i = 0; i < 4; i++) {
+    int sh = size_shift(sizes[i]);
+    if (sh < 0) return *why = "RAM sizes must be 0 or 64 << n bytes", NULL;
+    *shifts[i] = (uint8_t)sh;
+  }
+  if (strcmp(mirror, "H") == 0) e.mirror = NES_MIRROR_HORIZONTAL;
+  else if (strcmp(mirror, "V") == 0) e.mirror = NES_MIRROR_VERTICAL;
+  else if (strcmp(mirror, "4") == 0) e.mirror = NES_MIRROR_FOURSCREEN;
+  else return *why = "mirror must be H, V or 4", NULL;
+  if (strcmp(timing, "ntsc") == 0) e.timing = NES_TIMING_NTSC;
+  else if (strcmp(timing, "pal") == 0) e.timing = NES_TIMING_PAL;
+  else if (strcmp(timing, "multi") == 0) e.timing = NES_TIMING_MULTI;
+  else if (strcmp(timing, "dendy") == 0) e.timing = NES_TIMING_DENDY;
+  else return *why = "timing must be ntsc, pal, multi or dendy", NULL;
+
+  if (*count == *cap) {
+    *cap = *cap ? *cap * 2 : 64;
+    *rows = (row_t *)realloc(*rows, *cap * sizeof(**rows));
+    if (!*rows) {
+      fprintf(stderr, "oom\n");
+      exit(1);
+    }
+  }
+  row_t *r = &(*rows)[(*count)++];
+  memset(r, 0, sizeof(*r));
+  r->e = e;
+  return r;
+}
+
+// Copies a name, trimmed, without characters that would end the comment.
+static void set_name(row_t *r, const char *name, size_t n) {
+  while (n && isspace((unsigned char)*name)) name++, n--;
+  while (n && isspace((unsigned char)name[n - 1])) n--;
+  if (n >= sizeof(r->name)) n = sizeof(r->name) - 1;
+  for (size_t i = 0; i < n; i++) r->name[i] = (name[i] == '*' || name[i] == '\\') ? '_' : name[i];
+  r->name[n] = 0;
+}
+
+// Value of attribute `name` in the first <tag ...> inside [p, end); false if absent.
+static bool xml_attr(const char *p, const char *end, const char *tag, const char *name, char *out, size_t cap) {
+  char open[32];
+  snprintf(open, sizeof(open), "<%s ", tag);
+  const char *t = strstr(p, open);
+  if (!t || t >= end) return false;
+  const char *close = strchr(t, '>');
+  if (!close || close > end) return false;
+  char key[32];
+  snprintf(key, sizeof(key), " %s=\"", name);
+  const char *a = strstr(t, key);
+  if (!a || a > close) return false;
+  a += strlen(key);
+  size_t n = strcspn(a, "\"");
+  if (n >= cap) n = cap - 1;
+  memcpy(out, a, n);
+  out[n] = 0;
+  return true;
+}
+
+static unsigned long xml_ul(const char *p, const char *end, const char *tag, const char *name, int base) {
+  char v[32];
+  return xml_attr(p, end, tag, name, v, sizeof(v)) ? strtoul(v, NULL, base) : 0;
+}
+
+// Imports every <game> of an NES 2.0 XML database; games the table cannot
+// describe (8KB PRG, one-screen mirroring, ...) are counted and skipped.
+static void import_xml(const char *path, row_t **rows, size_t *count, size_t *cap) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "failed to open %s\n", path);
+    exit(1);
+  }
+  size_t len = 0, room = 1 << 20;
+  char *xml = (char *)malloc(room + 1);
+  for (size_t n; xml && (n = fread(xml + len, 1, room - len, f)) > 0;) {
+    len += n;
+    if (len == room) xml = (char *)realloc(xml, (room *= 2) + 1);
+  }
+  fclose(f);
+  if (!xml) {
+    fprintf(stderr, "oom\n");
+    exit(1);
+  }
+  xml[len] = 0;
+
+  static const char *const mirrors[] = { "H", "V", "4" };
+  static const char *const timings[] = { "ntsc", "pal", "multi", "dendy" };
+  size_t added = 0, skipped = 0;
+  const char *name = NULL, *name_end = NULL;
+  for (const char *p = xml; (p = strstr(p, "<")) != NULL;) {
+    if (strncmp(p, "<!--", 4) == 0) {
+      const char *e = strstr(p, "-->");
+      if (!e) break;
+      name = p + 4;
+      name_end = e;
+      p = e + 3;
+      continue;
+    }
+    if (strncmp(p, "<game>", 6) != 0) {
+      p++;
+      continue;
+    }
+    const char *end = strstr(p, "</game>");
+    if (!end) break;
+    char crc_s[16], mirror[4];
+    if (!xml_attr(p, end, "rom", "crc32", crc_s, sizeof(crc_s)) || !xml_attr(p, end, "pcb", "mirroring", mirror, sizeof(mirror))) {
+      skipped++;
+      p = end;
+      continue;
+    }
+    unsigned long sizes[4] = { xml_ul(p, end, "prgram", "size", 10), xml_ul(p, end, "prgnvram", "size", 10),
+                               xml_ul(p, end, "chrram", "size", 10), xml_ul(p, end, "chrnvram", "size", 10) };
+    unsigned long region = xml_ul(p, end, "console", "region", 10);
+    const char *m = "?";
+    for (int i = 0; i < 3; i++) {
+      if (strcmp(mirror, mirrors[i]) == 0) m = mirrors[i];
+    }
+    const char *why = NULL;
+    row_t *r = region < 4 ? add_row(rows, count, cap, strtoul(crc_s, NULL, 16), xml_ul(p, end, "pcb", "mapper", 10),
+                                    xml_ul(p, end, "pcb", "submapper", 10), xml_ul(p, end, "prgrom", "size", 10) / 1024,
+                                    xml_ul(p, end, "chrrom", "size", 10) / 1024, m, xml_ul(p, end, "pcb", "battery", 10),
+                                    sizes, timings[region], &why)
+                          : NULL;
+    if (r) {
+      // The comment before each <game> is its file name; drop the directory and extension.
+      if (name && name_end < p) {
+        const char *base = name;
+        for (const char *c = name; c < name_end; c++) {
+          if (*c == '\\' || *c == '/') base = c + 1;
+        }
+        const char *ext = name_end;
+        for (const char *c = base; c < name_end; c++) {
+          if (*c == '.') ext = c;
+        }
+        set_name(r, base, (size_t)(ext - base));
+      }
+      added++;
+    } else {
+      skipped++;
+    }
+    p = end;
+  }
+  free(xml);
+  fprintf(stderr, "%s: %zu entries imported, %zu skipped\n", path, added, skipped);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3 && argc != 4) {
+    fprintf(stderr, "usage: %s tools/romdb.txt src/romdb_table.h [nes20db.xml]\n", argv[0]);
+    return 2;
+  }
+  FILE *in = fopen(argv[1], "r");
+  if (!in) {
+    fprintf(stderr, "failed to open %s\n", argv[1]);
+    return 1;
+  }
+  row_t *rows = NULL;
+  size_t count = 0, cap = 0;
+  char buf[512];
+  int line = 0;
+  while (fgets(buf, sizeof(buf), in)) {
+    line++;
+    char *p = buf;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '#' || *p == 0) continue;
+
+    unsigned long crc, mapper, sub = 0, prg_kb, chr_kb, battery, sizes[4];
+    char mapper_s[32], mirror[8], timing[16];
+    int name_at = 0;
+    if (sscanf(p, "%lx %31s %lu %lu %7s %lu %lu %lu %lu %lu %15s %n", &crc, mapper_s, &prg_kb, &chr_kb, mirror,
+               &battery, &sizes[0], &sizes[1], &sizes[2], &sizes[3], timing, &name_at) < 11) {
+      die_line(argv[1], line, "expected: crc32 mapper[.sub] prg_kb chr_kb mirror battery prg_ram prg_nvram chr_ram chr_nvram timing name");
+    }
+    if (sscanf(mapper_s, "%lu.%lu", &mapper, &sub) < 1) die_line(argv[1], line, "bad mapper");
+    const char *why = NULL;
+    row_t *r = add_row(&rows, &count, &cap, crc, mapper, sub, prg_kb, chr_kb, mirror, battery, sizes, timing, &why);
+    if (!r) die_line(argv[1], line, why);
+
+    char *name = p + name_at;
+    set_name(r, name, strcspn(name, "\r\n"));
+  }
+  fclose(in);
+  size_t own = count;
+  if (argc == 4) import_xml(argv[3], &rows, &count, &cap);
+
+  // At most half full, so misses stop after a short probe.
+  uint32_t size = 16;
+  while (size < count * 2) size *= 2;
+  int *slot = (int *)malloc(size * sizeof(int));
+  if (!slot) return 1;
+  for (uint32_t i = 0; i < size; i++) slot[i] = -1;
+  for (size_t k = 0; k < count; k++) {
+    uint32_t i = rows[k].e.crc32 & (size - 1);
+    while (slot[i] >= 0) {
+      if (rows[slot[i]].e.crc32 == rows[k].e.crc32) {
+        if (k >= own) break; // romdb.txt overrides the imported database
+        fprintf(stderr, "%s: duplicate crc32 %08X (%s)\n", argv[1], rows[k].e.crc32, rows[k].name);
+        return 1;
+      }
+      i = (i + 1) & (size - 1);
+    }
+    if (slot[i] < 0) slot[i] = (int)k;
+  }
+
+  FILE *out = fopen(argv[2], "w");
+  if (!out) {
+    fprintf(stderr, "failed to open %s\n", argv[2]);
+    return 1;
+  }
+  fprintf(out, "// Generated by tools/mk_romdb from tools/romdb.txt%s%s; do not edit.\n", argc == 4 ? " and " : "",
+          argc == 4 ? argv[3] : "");
+  fprintf(out, "#pragma once\n#include \"romdb.h\"\n\n");
+  fprintf(out, "enum { ROMDB_TABLE_SIZE = %u };\n\n", size);
+  fprintf(out, "static const romdb_entry_t romdb_table[ROMDB_TABLE_SIZE] = {\n");
+  for (uint32_t i = 0; i < size; i++) {
+    if (slot[i] < 0) continue;
+    const row_t *r = &rows[slot[i]];
+    fprintf(out, "  [%u] = { 0x%08Xu, %u, %u, %u, %u, %u, %u, %u, %u, %u, %u, %u }, // %s\n", i, r->e.crc32,
+            r->e.mapper, r->e.submapper, r->e.flags, r->e.prg_rom_16k, r->e.chr_rom_8k, r->e.prg_ram_shift,
+            r->e.prg_nvram_shift, r->e.chr_ram_shift, r->e.chr_nvram_shift, r->e.mirror, r->e.timing, r->name);
+  }
+  fprintf(out, "};\n");
+  if (fclose(out) != 0) return 1;
+  fprintf(stderr, "%zu entries, table size %u\n", count, size);
+  free(slot);
+  free(rows);
+  return 0;
+}
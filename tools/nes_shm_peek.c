@@ -0,0 +1,71 @@
+// Samples the shared-memory export of a running `nes --shm <name>` and prints
+// the frame counter, framebuffer hash and a RAM window. Example reader for
+// out-of-process tools; `idx=` is the hash of the frame rebuilt from the index
+// plane, the per-line emphasis and the palette, which matches `fb=`.
+#define _POSIX_C_SOURCE 200809L
+#include "../src/shm_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint32_t fnv1a32(const void *data, size_t n) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <shm-name> [--ram ADDR LEN] [--follow <seconds>]\n", argv[0]);
+    return 2;
+  }
+  unsigned ram_addr = 0, ram_len = 16;
+  double follow = 0.0;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--ram") == 0 && i + 2 < argc) {
+      ram_addr = (unsigned)strtoul(argv[i + 1], NULL, 16) & 0x7FF;
+      ram_len = (unsigned)strtoul(argv[i + 2], NULL, 0);
+      i += 2;
+    } else if (strcmp(argv[i], "--follow") == 0 && i + 1 < argc) {
+      follow = atof(argv[++i]);
+    }
+  }
+  if (ram_addr + ram_len > 2048) ram_len = 2048 - ram_addr;
+
+  shm_export_t s;
+  char err[256];
+  if (!shm_export_attach(&s, argv[1], err, sizeof(err))) {
+    fprintf(stderr, "%s\n", err);
+    return 1;
+  }
+  static shm_export_data_t snap;
+  static uint32_t rebuilt[256 * 240];
+  struct timespec t0, now;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  uint64_t last_frame = ~0ull;
+  for (;;) {
+    if (shm_export_snapshot(&s, &snap, 1000) && snap.frame != last_frame) {
+      last_frame = snap.frame;
+      for (int i = 0; i < 256 * 240; i++) {
+        rebuilt[i] = s.region->palette[(snap.line_emphasis[i / 256] & 7) << 6 | (snap.pixel_index[i] & 63)];
+      }
+      printf("frame=%llu cycles=%llu fb=%08x idx=%08x ram[%03x]=", (unsigned long long)snap.frame,
+             (unsigned long long)snap.cpu_cycles, fnv1a32(snap.framebuffer, sizeof(snap.framebuffer)),
+             fnv1a32(rebuilt, sizeof(rebuilt)), ram_addr);
+      for (unsigned i = 0; i < ram_len; i++) printf("%02x", snap.ram[ram_addr + i]);
+      printf("\n");
+      fflush(stdout);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((double)(now.tv_sec - t0.tv_sec) + (double)(now.tv_nsec - t0.tv_nsec) * 1e-9 >= follow) break;
+    struct timespec nap = { 0, 5 * 1000 * 1000 };
+    nanosleep(&nap, NULL);
+  }
+  shm_export_detach(&s);
+  return 0;
+}
@@ -0,0 +1,159 @@
+// Converts a binary trace written by `nes --trace` into nestest.log-style text.
+#include "../src/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { M_IMP, M_ACC, M_IMM, M_ZP, M_ZPX, M_ZPY, M_IZX, M_IZY, M_REL, M_ABS, M_ABX, M_ABY, M_IND };
+
+typedef struct {
+  const char *name; // unofficial opcodes carry nestest's leading '*'
+  int mode;
+} opinfo_t;
+
+static const opinfo_t ops[256] = {
+  {"BRK", M_IMP}, {"ORA", M_IZX}, {"*JAM", M_IMP}, {"*SLO", M_IZX},
+  {"*NOP", M_ZP}, {"ORA", M_ZP}, {"ASL", M_ZP}, {"*SLO", M_ZP},
+  {"PHP", M_IMP}, {"ORA", M_IMM}, {"ASL", M_ACC}, {"*ANC", M_IMM},
+  {"*NOP", M_ABS}, {"ORA", M_ABS}, {"ASL", M_ABS}, {"*SLO", M_ABS},
+  {"BPL", M_REL}, {"ORA", M_IZY}, {"*JAM", M_IMP}, {"*SLO", M_IZY},
+  {"*NOP", M_ZPX}, {"ORA", M_ZPX}, {"ASL", M_ZPX}, {"*SLO", M_ZPX},
+  {"CLC", M_IMP}, {"ORA", M_ABY}, {"*NOP", M_IMP}, {"*SLO", M_ABY},
+  {"*NOP", M_ABX}, {"ORA", M_ABX}, {"ASL", M_ABX}, {"*SLO", M_ABX},
+  {"JSR", M_ABS}, {"AND", M_IZX}, {"*JAM", M_IMP}, {"*RLA", M_IZX},
+  {"BIT", M_ZP}, {"AND", M_ZP}, {"ROL", M_ZP}, {"*RLA", M_ZP},
+  {"PLP", M_IMP}, {"AND", M_IMM}, {"ROL", M_ACC}, {"*ANC", M_IMM},
+  {"BIT", M_ABS}, {"AND", M_ABS}, {"ROL", M_ABS}, {"*RLA", M_ABS},
+  {"BMI", M_REL}, {"AND", M_IZY}, {"*JAM", M_IMP}, {"*RLA", M_IZY},
+  {"*NOP", M_ZPX}, {"AND", M_ZPX}, {"ROL", M_ZPX}, {"*RLA", M_ZPX},
+  {"SEC", M_IMP}, {"AND", M_ABY}, {"*NOP", M_IMP}, {"*RLA", M_ABY},
+  {"*NOP", M_ABX}, {"AND", M_ABX}, {"ROL", M_ABX}, {"*RLA", M_ABX},
+  {"RTI", M_IMP}, {"EOR", M_IZX}, {"*JAM", M_IMP}, {"*SRE", M_IZX},
+  {"*NOP", M_ZP}, {"EOR", M_ZP}, {"LSR", M_ZP}, {"*SRE", M_ZP},
+  {"PHA", M_IMP}, {"EOR", M_IMM}, {"LSR", M_ACC}, {"*ALR", M_IMM},
+  {"JMP", M_ABS}, {"EOR", M_ABS}, {"LSR", M_ABS}, {"*SRE", M_ABS},
+  {"BVC", M_REL}, {"EOR", M_IZY}, {"*JAM", M_IMP}, {"*SRE", M_IZY},
+  {"*NOP", M_ZPX}, {"EOR", M_ZPX}, {"LSR", M_ZPX}, {"*SRE", M_ZPX},
+  {"CLI", M_IMP}, {"EOR", M_ABY}, {"*NOP", M_IMP}, {"*SRE", M_ABY},
+  {"*NOP", M_ABX}, {"EOR", M_ABX}, {"LSR", M_ABX}, {"*SRE", M_ABX},
+  {"RTS", M_IMP}, {"ADC", M_IZX}, {"*JAM", M_IMP}, {"*RRA", M_IZX},
+  {"*NOP", M_ZP}, {"ADC", M_ZP}, {"ROR", M_ZP}, {"*RRA", M_ZP},
+  {"PLA", M_IMP}, {"ADC", M_IMM}, {"ROR", M_ACC}, {"*ARR", M_IMM},
+  {"JMP", M_IND}, {"ADC", M_ABS}, {"ROR", M_ABS}, {"*RRA", M_ABS},
+  {"BVS", M_REL}, {"ADC", M_IZY}, {"*JAM", M_IMP}, {"*RRA", M_IZY},
+  {"*NOP", M_ZPX}, {"ADC", M_ZPX}, {"ROR", M_ZPX}, {"*RRA", M_ZPX},
+  {"SEI", M_IMP}, {"ADC", M_ABY}, {"*NOP", M_IMP}, {"*RRA", M_ABY},
+  {"*NOP", M_ABX}, {"ADC", M_ABX}, {"ROR", M_ABX}, {"*RRA", M_ABX},
+  {"*NOP", M_IMM}, {"STA", M_IZX}, {"*NOP", M_IMM}, {"*SAX", M_IZX},
+  {"STY", M_ZP}, {"STA", M_ZP}, {"STX", M_ZP}, {"*SAX", M_ZP},
+  {"DEY", M_IMP}, {"*NOP", M_IMM}, {"TXA", M_IMP}, {"*XAA", M_IMM},
+  {"STY", M_ABS}, {"STA", M_ABS}, {"STX", M_ABS}, {"*SAX", M_ABS},
+  {"BCC", M_REL}, {"STA", M_IZY}, {"*JAM", M_IMP}, {"*AHX", M_IZY},
+  {"STY", M_ZPX}, {"STA", M_ZPX}, {"STX", M_ZPY}, {"*SAX", M_ZPY},
+  {"TYA", M_IMP}, {"STA", M_ABY}, {"TXS", M_IMP}, {"*TAS", M_ABY},
+  {"*SHY", M_ABX}, {"STA", M_ABX}, {"*SHX", M_ABY}, {"*AHX", M_ABY},
+  {"LDY", M_IMM}, {"LDA", M_IZX}, {"LDX", M_IMM}, {"*LAX", M_IZX},
+  {"LDY", M_ZP}, {"LDA", M_ZP}, {"LDX", M_ZP}, {"*LAX", M_ZP},
+  {"TAY", M_IMP}, {"LDA", M_IMM}, {"TAX", M_IMP}, {"*LXA", M_IMM},
+  {"LDY", M_ABS}, {"LDA", M_ABS}, {"LDX", M_ABS}, {"*LAX", M_ABS},
+  {"BCS", M_REL}, {"LDA", M_IZY}, {"*JAM", M_IMP}, {"*LAX", M_IZY},
+  {"LDY", M_ZPX}, {"LDA", M_ZPX}, {"LDX", M_ZPY}, {"*LAX", M_ZPY},
+  {"CLV", M_IMP}, {"LDA", M_ABY}, {"TSX", M_IMP}, {"*LAS", M_ABY},
+  {"LDY", M_ABX}, {"LDA", M_ABX}, {"LDX", M_ABY}, {"*LAX", M_ABY},
+  {"CPY", M_IMM}, {"CMP", M_IZX}, {"*NOP", M_IMM}, {"*DCP", M_IZX},
+  {"CPY", M_ZP}, {"CMP", M_ZP}, {"DEC", M_ZP}, {"*DCP", M_ZP},
+  {"INY", M_IMP}, {"CMP", M_IMM}, {"DEX", M_IMP}, {"*AXS", M_IMM},
+  {"CPY", M_ABS}, {"CMP", M_ABS}, {"DEC", M_ABS}, {"*DCP", M_ABS},
+  {"BNE", M_REL}, {"CMP", M_IZY}, {"*JAM", M_IMP}, {"*DCP", M_IZY},
+  {"*NOP", M_ZPX}, {"CMP", M_ZPX}, {"DEC", M_ZPX}, {"*DCP", M_ZPX},
+  {"CLD", M_IMP}, {"CMP", M_ABY}, {"*NOP", M_IMP}, {"*DCP", M_ABY},
+  {"*NOP", M_ABX}, {"CMP", M_ABX}, {"DEC", M_ABX}, {"*DCP", M_ABX},
+  {"CPX", M_IMM}, {"SBC", M_IZX}, {"*NOP", M_IMM}, {"*ISB", M_IZX},
+  {"CPX", M_ZP}, {"SBC", M_ZP}, {"INC", M_ZP}, {"*ISB", M_ZP},
+  {"INX", M_IMP}, {"SBC", M_IMM}, {"NOP", M_IMP}, {"*SBC", M_IMM},
+  {"CPX", M_ABS}, {"SBC", M_ABS}, {"INC", M_ABS}, {"*ISB", M_ABS},
+  {"BEQ", M_REL}, {"SBC", M_IZY}, {"*JAM", M_IMP}, {"*ISB", M_IZY},
+  {"*NOP", M_ZPX}, {"SBC", M_ZPX}, {"INC", M_ZPX}, {"*ISB", M_ZPX},
+  {"SED", M_IMP}, {"SBC", M_ABY}, {"*NOP", M_IMP}, {"*ISB", M_ABY},
+  {"*NOP", M_ABX}, {"SBC", M_ABX}, {"INC", M_ABX}, {"*ISB", M_ABX},
+};
+
+static void die(const char *msg) {
+  fprintf(stderr, "%s\n", msg);
+  exit(1);
+}
+
+static void format_operand(char *out, size_t cap, const trace_record_t *r, const opinfo_t *oi) {
+  uint8_t lo = r->bytes[1];
+  uint16_t w = (uint16_t)(r->bytes[1] | (r->bytes[2] << 8));
+  switch (oi->mode) {
+    case M_ACC: snprintf(out, cap, "A"); break;
+    case M_IMM: snprintf(out, cap, "#$%02X", lo); break;
+    case M_ZP: snprintf(out, cap, "$%02X", lo); break;
+    case M_ZPX: snprintf(out, cap, "$%02X,X", lo); break;
+    case M_ZPY: snprintf(out, cap, "$%02X,Y", lo); break;
+    case M_IZX: snprintf(out, cap, "($%02X,X)", lo); break;
+    case M_IZY: snprintf(out, cap, "($%02X),Y", lo); break;
+    case M_REL: snprintf(out, cap, "$%04X", (uint16_t)(r->pc + 2 + (int8_t)lo)); break;
+    case M_ABS: snprintf(out, cap, "$%04X", w); break;
+    case M_ABX: snprintf(out, cap, "$%04X,X", w); break;
+    case M_ABY: snprintf(out, cap, "$%04X,Y", w); break;
+    case M_IND: snprintf(out, cap, "($%04X)", w); break;
+    default: out[0] = '\0'; break;
+  }
+}
+
+static void print_record(FILE *out, const trace_record_t *r) {
+  const opinfo_t *oi = &ops[r->bytes[0]];
+  char bytes[16];
+  int len = (r->len >= 1 && r->len <= 3) ? r->len : 1;
+  if (len == 1) snprintf(bytes, sizeof(bytes), "%02X", r->bytes[0]);
+  else if (len == 2) snprintf(bytes, sizeof(bytes), "%02X %02X", r->bytes[0], r->bytes[1]);
+  else snprintf(bytes, sizeof(bytes), "%02X %02X %02X", r->bytes[0], r->bytes[1], r->bytes[2]);
+
+  char operand[16];
+  format_operand(operand, sizeof(operand), r, oi);
+  // The column before the mnemonic holds nestest's '*' marker for unofficial opcodes.
+  char dis[48];
+  snprintf(dis, sizeof(dis), "%s%s%s%s", oi->name[0] == '*' ? "" : " ", oi->name, operand[0] ? " " : "", operand);
+
+  // nestest numbers the pre-render line 261 rather than -1.
+  int scanline = (r->scanline < 0) ? 261 : r->scanline;
+  fprintf(out, "%04X  %-8s %-33sA:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu\n",
+          r->pc, bytes, dis, r->a, r->x, r->y, r->p, r->sp, scanline, r->dot,
+          (unsigned long long)r->cycles);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s trace.bin [out.log]\n", argv[0]);
+    return 2;
+  }
+  FILE *f = fopen(argv[1], "rb");
+  if (!f) die("failed to open trace file");
+  FILE *out = stdout;
+  if (argc >= 3) {
+    out = fopen(argv[2], "w");
+    if (!out) die("failed to open output file");
+  }
+
+  trace_file_header_t h;
+  if (fread(&h, sizeof(h), 1, f) != 1) die("short trace header");
+  if (memcmp(h.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0) die("not a trace file");
+  if (h.record_size != sizeof(trace_record_t)) die("unsupported trace record size");
+  if (h.total > h.count) fprintf(stderr, "note: ring wrapped, first %llu records were dropped\n",
+                                 (unsigned long long)(h.total - h.count));
+
+  trace_record_t buf[4096];
+  uint32_t left = h.count;
+  while (left > 0) {
+    size_t want = (left < 4096) ? left : 4096;
+    size_t got = fread(buf, sizeof(trace_record_t), want, f);
+    for (size_t i = 0; i < got; i++) print_record(out, &buf[i]);
+    if (got != want) die("truncated trace file");
+    left -= (uint32_t)got;
+  }
+  fclose(f);
+  if (out != stdout && fclose(out) != 0) die("failed writing output");
+  return 0;
+}